@@ -50,9 +50,42 @@
 //               saving the results to flash. Only calibrated at POC
 //               however temperature will affect the values and clock
 //               An improvement to the code would be to run occasionally
+//
+// RECALIBRATE_DCO that improvement. Keeps measuring SMCLK against the crystal
+//               using the WDT as an interval timer while softserial runs and
+//               nudges the DCO one step between frames when it drifts.
 //-------------------------------------------------------------------------
 #define CALIBRATE_DCO       // on by default
+//#define RECALIBRATE_DCO   // uses the WDT, so no watchdog while it runs
 #define RX_BUFFER_SIZE 16   // Set the size of the ring buffer data needs to be a power of 2
+#define TX_BUFFER_SIZE 16   // Set the size of the xmit ring buffer, also a power of 2
+//#define SOFTSERIAL_USCI     // same API on the USCI_A0 hardware UART (msp430g2553), TX P1.2 RX P1.1. Leaves Timer0_A free
+//#define SOFTSERIAL_TX_EDGES // TX interrupts only when the line changes instead of every bit
+//#define SOFTSERIAL_RX_EDGES // RX timestamps edges instead of sampling every bit, needs CCR2 (msp430g2553)
+//#define SOFTSERIAL_RX_VOTE  // 3 sample majority per bit, with RX_EDGES drop glitches and resync on every edge, see SoftSerial_rx_skew()
+//#define SOFTSERIAL_VOTE_TICKS 24 // time between the samples, default 1/16 bit
+//#define SOFTSERIAL_PORTS    // extra SoftSerial_t ports on Timer1_A3 (msp430g2553), see softserial_port.h
+//#define SOFTSERIAL_RUNTIME_BAUD // SoftSerial_set_baud() and SoftSerial_autobaud(), BAUD_RATE is only the starting rate
+//#define SOFTSERIAL_STATS    // RX error counters and ISR latency histogram, see SoftSerial_get_stats()
+//#define SOFTSERIAL_LOWPOWER // xmit()/flush() wait in LPM0, SoftSerial_sleep() until SoftSerial_wake_on() conditions
+//#define SOFTSERIAL_LPM3     // SoftSerial_sleep() uses LPM3 on an idle line, takes PORT1_VECTOR to wake on a start bit
+//#define SOFTSERIAL_WAKE_TICKS 24 // LPM3 wake up time in SMCLK ticks, the start bit is back dated by this much
+//#define SOFTSERIAL_RTSCTS   // RTS/CTS flow control on RTS_PIN/CTS_PIN, see softserial.h
+//#define SOFTSERIAL_XONXOFF  // XON/XOFF flow control, 0x11 and 0x13 can't be sent as data then
+//#define SOFTSERIAL_RS485    // half duplex bus, DE_PIN on until the stop bit is out, no echo, see SoftSerial_address()
+//#define SOFTSERIAL_FLOW_HIGH 8 // rx_buffer count that stops the sender, default RX_BUFFER_SIZE/2
+//#define SOFTSERIAL_FLOW_LOW  4 // rx_buffer count that lets it go on, default RX_BUFFER_SIZE/4
+//#define SOFTSERIAL_FRAMING 'C' // RX ISR decodes 'C'OBS or 'S'LIP frames with a CRC-16, see SoftSerial_frame_read()
+                                 // or 'G' ends frames on a 3.5 character idle Gap like Modbus RTU, uses CCR2 (msp430g2553)
+//#define SOFTSERIAL_FRAME_QUEUE 4 // complete frames that can wait, a power of 2
+//#define SOFTSERIAL_GAP_TICKS 3225 // fixed 'G' gap, Modbus wants 1.75ms above 19200 baud (3225 @ F_CPU 1843200)
+//#define SOFTSERIAL_BREAK    // breaks go to a callback instead of the rx_buffer, idle line events, SoftSerial_send_break()
+//#define SOFTSERIAL_STAMPS   // remember the start bit time of every character, see SoftSerial_stamp()
+//#define SOFTSERIAL_RECEIVE  // SoftSerial_receive_into() lets the RX ISR fill your buffer, skipping the rx_buffer
+//#define SOFTSERIAL_BRIDGE   // RX ISR forwards bytes to a TX queue, echo or repeater, see SoftSerial_bridge()
+//#define SOFTSERIAL_TIMERS 4 // software timers on TIMER0_A next to the UART, see SoftSerial_timer_start()
+//#define SOFTSERIAL_TIMER_TICKS 3686 // timer tick in SMCLK ticks, default F_CPU/1000 (1ms)
+//#define SOFTSERIAL_PRINT    // decimal/hex/fixed point output without division, see softserial_print.h
 //#define F_CPU 16000000    // fastest clock, factory calibrated sometimes
 //#define F_CPU 12000000    // a popular faster clock, factory calibrated sometimes
 //#define F_CPU 14745600    // I like this one
@@ -65,4 +98,37 @@
 
 #define BAUD_RATE 9600      // launchpad max speed is 9600. However an FT232RL can go faster
                             // http://www.sparkfun.com/products/718 - FT232RL Breakout Board
+//#define BAUD_RATE 19200
+//#define BAUD_RATE 38400
+//#define BAUD_RATE 57600
+//#define BAUD_RATE 115200
+
+//-------------------------------------------------------------------------
+// SOFTSERIAL_ISR_CYCLES the full-duplex worst case of the TX and RX ISRs
+//               in cycles. isr_budget.py works it out from the compiler
+//               output for every F_CPU/BAUD_RATE/RX_BUFFER_SIZE listed here,
+//               with the features you pass it. Set it and the build fails
+//               when a bit is shorter than that, MCLK == SMCLK assumed.
+//-------------------------------------------------------------------------
+//#define SOFTSERIAL_ISR_CYCLES 250
+
+//-------------------------------------------------------------------------
+// Frame format, 8-N-1 when these are left out. Only 8-N-1 and 8-N-2 keep
+//               the byte sized RX ISR, other formats cost a few cycles per
+//               bit. Parity is added by xmit() and checked by the RX ISR,
+//               characters with bad parity are dropped. 9 data bits are
+//               sent with SoftSerial_xmit9(). The softserial_port.c ports
+//               are always 8-N-1.
+//-------------------------------------------------------------------------
+//#define SOFTSERIAL_DATA_BITS 7    // 5 to 9
+//#define SOFTSERIAL_PARITY   'E'   // 'N'one, 'E'ven or 'O'dd
+//#define SOFTSERIAL_STOP_BITS 1    // 1 or 2
+
+//-------------------------------------------------------------------------
+// BAUD_FRAME_ERROR_MAX the build fails if rounding F_CPU/BAUD_RATE to whole
+//               timer ticks makes the last bit of a frame drift more than
+//               this many percent of a bit time. Does not know how far off
+//               your DCO really is, so leave some room for that.
+//-------------------------------------------------------------------------
+#define BAUD_FRAME_ERROR_MAX 10
 #endif
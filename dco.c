@@ -0,0 +1,175 @@
+/**
+ * dco.c - set the DCO to F_CPU and keep it there using the 32.768k watch crystal
+ *
+ * Set_DCO() takes over TIMERA, so it can only run before SoftSerial_init().
+ *
+ * DCO_track_start() is for after that. It uses the watchdog as an interval
+ * timer clocked from ACLK and counts how far the free running TIMERA (SMCLK)
+ * moved between WDT interrupts. When the count is off by more than about half
+ * a DCOCTL step the DCO is nudged one step, but only while SoftSerial_idle()
+ * says no frame is on the wire, so a byte never sees two different clocks.
+ * Temperature drift is slow, so an occasional nudge is all it takes.
+ *
+ * License: Do with this code what you want. However, don't blame
+ * me if you connect it to a heart pump and it stops.  This source
+ * is provided as is with no warranties. It probably has bugs!!
+ * You have been warned!
+ *
+ * Author: Rick Kimball
+ * email: rick@kimballsoftware.com
+ */
+
+#include <msp430.h>
+#include <stdint.h>
+#include "config.h"
+#include "softserial.h"
+#include "dco.h"
+
+/**
+ * DCO_slower()/DCO_faster() - move the DCO one DCOCTL step, switch RSEL on roll over
+ */
+
+static void DCO_slower(void)
+{
+    DCOCTL--;                               // DCO is too fast, slow it down
+    if (DCOCTL == 0xFF)                     // Did DCO roll under?
+    if (BCSCTL1 & 0x0f)
+        BCSCTL1--;                          // Select lower RSEL
+}
+
+static void DCO_faster(void)
+{
+    DCOCTL++;                               // DCO is too slow, speed it up
+    if (DCOCTL == 0x00)                     // Did DCO roll over?
+    if ((BCSCTL1 & 0x0f) != 0x0f)
+        BCSCTL1++;                          // Select higher RSEL
+}
+
+#if defined(CALIBRATE_DCO)
+//--------------------------------------------------------------------------
+void Set_DCO(unsigned int Delta)            // Set DCO to F_CPU
+//--------------------------------------------------------------------------
+{
+    unsigned int Compare, Oldcapture = 0;
+
+    BCSCTL1 |= DIVA_3;                      // ACLK = LFXT1CLK/8
+    TACCTL0 = CM_1 | CCIS_1 | CAP;          // CAP, ACLK
+    TACTL = TASSEL_2 | MC_2 | TACLR;        // SMCLK, continuous mode, clear
+
+    while (1) {
+        while (!(CCIFG & TACCTL0));         // Wait until capture occurred
+        TACCTL0 &= ~CCIFG;                  // Capture occurred, clear flag
+        Compare = TACCR0;                   // Get current captured SMCLK
+        Compare = Compare - Oldcapture;     // SMCLK difference
+        Oldcapture = TACCR0;                // Save current captured SMCLK
+
+        if (Delta == Compare) break;        // If equal, leave "while(1)"
+        else if (Delta < Compare) {
+            DCO_slower();
+        }
+        else {
+            DCO_faster();
+        }
+    }
+    TACCTL0 = 0;                            // Stop TACCR0
+    TACTL = 0;                              // Stop Timer_A
+    BCSCTL1 &= ~DIVA_3;                     // ACLK = LFXT1CLK
+}
+#endif
+
+#if defined(RECALIBRATE_DCO)
+
+#if defined(SOFTSERIAL_LPM3)
+    #error RECALIBRATE_DCO counts SMCLK ticks, SMCLK stops in LPM3. Use one or the other.
+#endif
+
+/**
+ * The WDT fires every 64 ACLK cycles (1/512 s). A window of that many
+ * intervals adds up to about 2^18 SMCLK ticks, so the interrupt latency
+ * jitter at both ends of the window stays well below the dead band.
+ */
+#define DCO_TRACK_WINDOW   ((262144UL * 512 / F_CPU) > 255 ? 255 : (262144UL * 512 / F_CPU))
+#define DCO_TRACK_EXPECT   ((uint32_t)(F_CPU / 512) * DCO_TRACK_WINDOW) // SMCLK ticks in one window
+#define DCO_TRACK_DEADBAND (DCO_TRACK_EXPECT / 512)                     // ~0.2%, about half a DCOCTL step
+
+static uint16_t dco_last;   // TAR at the previous WDT interrupt
+static uint32_t dco_ticks;  // SMCLK ticks counted so far in this window
+static uint8_t dco_count;   // WDT intervals left in this window, 0 means start a new one
+static int8_t dco_nudge;    // step waiting for softserial to go idle, -1 slower, +1 faster
+
+/**
+ * DCO_track_start() - start measuring SMCLK against ACLK, call after SoftSerial_init()
+ *
+ * Takes over the watchdog as an interval timer.
+ */
+
+void DCO_track_start(void)
+{
+    dco_count = 0;
+    dco_nudge = 0;
+    WDTCTL = WDT_ADLY_1_9;                  // interval timer, ACLK/64
+    IE1 |= WDTIE;
+}
+
+/**
+ * DCO_track_stop() - stop tracking and put the watchdog back on hold
+ */
+
+void DCO_track_stop(void)
+{
+    IE1 &= ~WDTIE;
+    WDTCTL = WDTPW + WDTHOLD;
+}
+
+/**
+ * DCO_track_ISR - WDT interval handler
+ */
+
+SOFTSERIAL_ISR(WDT_VECTOR, DCO_track_ISR)
+{
+    register uint16_t now = TAR;
+
+    if (!(TACTL & MC_2)) {
+        dco_nudge = 0;                      // SoftSerial_end() stopped TIMERA, nothing to count
+        dco_count = 0;
+        return;
+    }
+
+    if (dco_nudge) {
+        if (!SoftSerial_idle()) {
+            return;                         // a frame is on the wire, try again next interval
+        }
+        if (dco_nudge < 0) {
+            DCO_slower();
+        }
+        else {
+            DCO_faster();
+        }
+        dco_nudge = 0;
+        dco_count = 0;                      // the old count is stale now
+    }
+
+    if (!dco_count) {                       // start a new window
+        dco_last = now;
+        dco_ticks = 0;
+        dco_count = DCO_TRACK_WINDOW;
+        return;
+    }
+
+    dco_ticks += (uint16_t)(now - dco_last);
+    dco_last = now;
+
+    if (--dco_count) {
+        return;
+    }
+
+    if (dco_ticks > DCO_TRACK_EXPECT + DCO_TRACK_DEADBAND) {
+        dco_nudge = -1;
+    }
+    else if (dco_ticks < DCO_TRACK_EXPECT - DCO_TRACK_DEADBAND) {
+        dco_nudge = 1;
+    }
+    dco_count = DCO_TRACK_WINDOW;           // keep counting, the window starts where this one ended
+    dco_ticks = 0;
+}
+#endif
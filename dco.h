@@ -0,0 +1,28 @@
+/**
+ * dco.h - set the DCO to F_CPU and keep it there using the 32.768k watch crystal
+ *
+ * License: Do with this code what you want. However, don't blame
+ * me if you connect it to a heart pump and it stops.  This source
+ * is provided as is with no warranties. It probably has bugs!!
+ * You have been warned!
+ *
+ * Author: Rick Kimball
+ * email: rick@kimballsoftware.com
+ */
+
+#ifndef DCO_H_
+#define DCO_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void Set_DCO(unsigned int Delta);   // use external 32.768k clock to calibrate and set F_CPU speed
+
+void DCO_track_start(void);         // keep nudging the DCO towards F_CPU while softserial runs
+void DCO_track_stop(void);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+#endif /*DCO_H_*/
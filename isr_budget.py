@@ -0,0 +1,433 @@
+#!/usr/bin/env python3
+"""
+isr_budget.py - worst case cycle count of the softserial ISRs for every config
+
+Builds softserial.c with msp430-gcc once for each F_CPU, BAUD_RATE and
+RX_BUFFER_SIZE listed in config.h, commented out or not. It reads the
+generated assembly of SoftSerial_TX_ISR and SoftSerial_RX_ISR and adds
+up the MSP430 cycle table over the longest path through each one,
+including interrupt entry and reti. Then it prints the headroom in a
+bit period and the flash/RAM size of each config:
+
+    ./isr_budget.py
+    ./isr_budget.py --cflags "-DSOFTSERIAL_TX_EDGES -DSOFTSERIAL_STATS" --mmcu msp430g2553
+
+Full duplex, the TX and the RX ISR can both be due in the same bit. So
+the budget is both worst paths, two interrupt entries and the longest
+instruction the CPU may be in the middle of. It has to fit in one bit
+time, counted in SMCLK ticks, which assumes MCLK == SMCLK. The exit code
+is 1 if any config does not fit. Put the duplex number of your config
+into config.h as SOFTSERIAL_ISR_CYCLES and softserial.c will refuse
+baud rates that are too fast for it, in place of the 378 tick guess.
+
+Loops are counted --loop-bound times each, taken as if they could all
+be on the same path, so the result errs on the long side. Calls
+through pointers (timer callbacks) and into libgcc are not followed,
+they show up as a '+' after the count.
+
+Experimental: the cycle table and the assembly parser have not been run
+against a real msp430-gcc build yet. Check its numbers with a scope on
+a TX pin before you trust SOFTSERIAL_ISR_CYCLES to them.
+
+License: Do with this code what you want. However, don't blame
+me if you connect it to a heart pump and it stops.  This source
+is provided as is with no warranties. It probably has bugs!!
+You have been warned!
+"""
+
+import argparse
+import os
+import re
+import shutil
+import subprocess
+import sys
+import tempfile
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+SOURCES = ["softserial.c", "softserial.h", "config.h"]
+ISRS = ["SoftSerial_TX_ISR", "SoftSerial_RX_ISR"]
+
+IRQ_ENTRY = 6       # push PC and SR, load the vector
+IRQ_LATENCY = 6     # longest instruction in progress when the interrupt comes
+
+#--------------------------------------------------------------------------------
+# MSP430 (not MSP430X) cycle table, from the family user guide
+#--------------------------------------------------------------------------------
+
+# double operand, [source mode][destination mode]
+FORMAT_I = {
+    "reg": {"reg": 1, "pc": 2, "mem": 4},
+    "ind": {"reg": 2, "pc": 2, "mem": 5},
+    "inc": {"reg": 2, "pc": 3, "mem": 5},
+    "imm": {"reg": 2, "pc": 3, "mem": 5},
+    "mem": {"reg": 3, "pc": 3, "mem": 6},
+}
+
+# single operand, [instruction][operand mode]
+FORMAT_II = {
+    "rrc":  {"reg": 1, "ind": 3, "inc": 3, "mem": 4},
+    "push": {"reg": 3, "ind": 4, "inc": 4, "imm": 4, "mem": 5},
+    "call": {"reg": 4, "ind": 4, "inc": 5, "imm": 5, "mem": 5},
+}
+FORMAT_II["rra"] = FORMAT_II["swpb"] = FORMAT_II["sxt"] = FORMAT_II["rrc"]
+
+DOUBLE = {"mov", "add", "addc", "sub", "subc", "cmp", "dadd", "bit", "bic", "bis", "xor", "and"}
+JUMPS = {"jne", "jnz", "jeq", "jz", "jnc", "jlo", "jc", "jhs", "jn", "jge", "jl", "jmp"}
+
+# emulated instructions, what they really are
+EMULATED = {
+    "adc":  ("addc", "#0"), "dadc": ("dadd", "#0"), "sbc": ("subc", "#0"),
+    "inc":  ("add", "#1"),  "incd": ("add", "#2"),
+    "dec":  ("sub", "#1"),  "decd": ("sub", "#2"),
+    "inv":  ("xor", "#-1"), "tst":  ("cmp", "#0"), "clr": ("mov", "#0"),
+    "pop":  ("mov", "@sp+"),
+}
+ONE_CYCLE = {"nop", "clrc", "clrn", "clrz", "setc", "setn", "setz", "dint", "eint"}
+CONSTANTS = {"0", "1", "2", "4", "8", "-1", "0xffff", "65535", "0xff", "255"}
+REGISTER = re.compile(r"^(r\d{1,2}|pc|sp|sr|cg)$")
+
+
+def mode(op):
+    """operand addressing mode as the cycle table wants it"""
+    op = op.strip().lower()
+    if REGISTER.match(op):
+        return "pc" if op in ("r0", "pc") else "reg"
+    if op.startswith("@"):
+        return "inc" if op.endswith("+") else "ind"
+    if op.startswith("#"):
+        return "reg" if op[1:] in CONSTANTS else "imm"     # the constant generator costs nothing
+    return "mem"                                            # x(Rn), symbolic and &absolute
+
+
+def split_operands(text):
+    ops, depth, cur = [], 0, ""
+    for ch in text:
+        if ch == "(":
+            depth += 1
+        elif ch == ")":
+            depth -= 1
+        if ch == "," and not depth:
+            ops.append(cur.strip())
+            cur = ""
+        else:
+            cur += ch
+    if cur.strip():
+        ops.append(cur.strip())
+    return ops
+
+
+class Insn:
+    def __init__(self, mnemonic, ops, line):
+        self.op = mnemonic
+        self.ops = ops
+        self.line = line
+        self.cycles = 0
+        self.call = None        # callee name, or "?" if we can't follow it
+        self.targets = []       # jump targets, labels
+        self.falls = True       # execution can go on with the next instruction
+        self.exit = False       # ret or reti
+        self.table = None       # br through a jump table at this label
+
+
+def cycles_of(insn):
+    op, ops = insn.op, insn.ops
+
+    if op in ONE_CYCLE:
+        return 1
+    if op in JUMPS:
+        return 2
+    if op == "reti":
+        return 5
+    if op == "ret":
+        return FORMAT_I["inc"]["pc"]
+    if op == "br":
+        return FORMAT_I[mode(ops[0]) if mode(ops[0]) != "pc" else "reg"]["pc"]
+    if op in ("rla", "rlc"):
+        m = mode(ops[0])
+        return FORMAT_I["reg" if m == "pc" else m]["mem" if m == "mem" else "reg"]
+    if op in EMULATED:
+        real, src = EMULATED[op]
+        return FORMAT_I[mode(src)][mode(ops[0])]
+    if op in DOUBLE:
+        src = mode(ops[0])
+        return FORMAT_I["reg" if src == "pc" else src][mode(ops[1])]
+    if op in FORMAT_II:
+        m = mode(ops[0])
+        return FORMAT_II[op]["reg" if m == "pc" else m]
+    if op in ("pushm", "popm"):     # MSP430X, 2 + one per register
+        return 2 + int(ops[0].lstrip("#"), 0)
+    raise ValueError("unknown instruction: " + insn.line)
+
+
+def parse_asm(text):
+    """
+    msp430-gcc -S output into {function: [Insn]} and {label: [labels]} for
+    the .word jump tables. Both the old lower case mspgcc and the upper case
+    msp430-elf-gcc syntax work.
+    """
+    funcs, tables = {}, {}
+    cur, table = None, None
+
+    for raw in text.splitlines():
+        line = raw.split(";")[0].rstrip()
+        for part in line.split("{"):            # msp430-elf-gcc puts CMP { JNE on one line
+            part = part.strip()
+            if not part:
+                continue
+            m = re.match(r"^([\w.$]+):\s*(.*)$", part)
+            if m:
+                label, part = m.group(1), m.group(2).strip()
+                if not label.startswith("."):
+                    cur = funcs.setdefault(label, [])
+                    table = None
+                elif cur is not None:
+                    cur.append(Insn(":", [label], raw))
+                    table = tables.setdefault(label, [])
+                if not part:
+                    continue
+            if part.startswith("."):
+                if part.lower().startswith(".word") and table is not None:
+                    table.extend(o.strip() for o in part[5:].split(","))
+                elif part.lower().startswith((".size", ".section", ".text")):
+                    table = None
+                continue
+            if cur is None:
+                continue
+            table = None
+            words = part.split(None, 1)
+            mnemonic = words[0].lower().split(".")[0]   # drop .b/.w/.a
+            ops = split_operands(words[1]) if len(words) > 1 else []
+            insn = Insn(mnemonic, ops, raw.strip())
+            insn.cycles = cycles_of(insn)
+            if mnemonic in JUMPS:
+                insn.targets = [ops[0]]
+                insn.falls = mnemonic != "jmp"
+            elif mnemonic in ("ret", "reti"):
+                insn.falls, insn.exit = False, True
+            elif mnemonic == "br" or (mnemonic in DOUBLE and mode(ops[-1]) == "pc"):
+                insn.falls = False
+                src = ops[0]
+                if src.startswith("#"):
+                    insn.targets = [src[1:]]
+                elif "(" in src:
+                    insn.table = src.split("(")[0]
+                else:
+                    insn.table = "?"
+            elif mnemonic == "call":
+                insn.call = ops[0][1:] if ops[0].startswith("#") else "?"
+            cur.append(insn)
+    return funcs, tables
+
+
+class Budget:
+    """longest path through a function, loops counted loop_bound times"""
+
+    def __init__(self, funcs, tables, loop_bound):
+        self.funcs, self.tables, self.loop_bound = funcs, tables, loop_bound
+        self.memo = {}
+
+    def cost(self, name, stack=()):
+        """(cycles, exact) of the function, exact is False if something was not followed"""
+        if name in self.memo:
+            return self.memo[name]
+        if name not in self.funcs or name in stack:
+            return 0, False
+
+        code = self.funcs[name]
+        labels = {i.ops[0]: n for n, i in enumerate(code) if i.op == ":"}
+        exact = True
+        succ = []
+        for n, insn in enumerate(code):
+            s = []
+            if insn.falls and n + 1 < len(code):
+                s.append(n + 1)
+            for t in insn.targets:
+                if t in labels:
+                    s.append(labels[t])
+                elif t.startswith(("$", ".")) and t[1:].lstrip("+-").isdigit():
+                    exact = False       # relative jump, not expected in gcc output
+                else:
+                    exact = False       # tail call into another function
+            if insn.table is not None:
+                entries = self.tables.get(insn.table, [])
+                if not entries:
+                    exact = False
+                s.extend(labels[e] for e in entries if e in labels)
+            succ.append(s)
+
+        weight = []
+        for insn in code:
+            w = insn.cycles
+            if insn.call:
+                c, e = self.cost(insn.call, stack + (name,)) if insn.call != "?" else (0, False)
+                w += c
+                exact = exact and e
+            weight.append(w)
+
+        # back edges make the loops, without them the rest is a DAG
+        back, state = set(), [0] * len(code)
+        work = [(0, iter(succ[0]))] if code else []
+        state[0] = 1 if code else 0
+        while work:
+            node, it = work[-1]
+            nxt = next(it, None)
+            if nxt is None:
+                state[node] = 2
+                work.pop()
+            elif state[nxt] == 1:
+                back.add((node, nxt))
+            elif state[nxt] == 0:
+                state[nxt] = 1
+                work.append((nxt, iter(succ[nxt])))
+
+        dag = [[t for t in s if (n, t) not in back] for n, s in enumerate(succ)]
+
+        def longest(start, stop=None, inside=None):
+            best = {}
+            order, seen, work = [], set(), [(start, False)]
+            while work:                 # reverse post order, no recursion limit trouble
+                node, done = work.pop()
+                if done:
+                    order.append(node)
+                    continue
+                if node in seen:
+                    continue
+                seen.add(node)
+                work.append((node, True))
+                for t in dag[node]:
+                    if (inside is None or t in inside) and t not in seen:
+                        work.append((t, False))
+            for node in order:          # successors come first
+                tails = [best[t] for t in dag[node] if t in best and (inside is None or t in inside)]
+                if node == stop:
+                    best[node] = weight[node]
+                elif tails:
+                    best[node] = weight[node] + max(tails)
+                elif stop is None and code[node].exit:
+                    best[node] = weight[node]
+            return best.get(start, 0)
+
+        total = longest(0) if code else 0
+        for tail, head in back:
+            body = {head}
+            work = [tail]
+            while work:                 # the natural loop, everything that gets to tail without head
+                node = work.pop()
+                if node not in body:
+                    body.add(node)
+                    work.extend(p for p, s in enumerate(succ) if node in s)
+            total += (self.loop_bound - 1) * longest(head, tail, body)
+
+        self.memo[name] = (total, exact)
+        return self.memo[name]
+
+
+#--------------------------------------------------------------------------------
+# configs and the compiler
+#--------------------------------------------------------------------------------
+
+def listed(config, name):
+    """every value config.h has for name, commented out or not, in file order"""
+    values = []
+    for m in re.finditer(r"^\s*(?://)?\s*#define\s+" + name + r"\s+(\d+)", config, re.M):
+        if int(m.group(1)) not in values:
+            values.append(int(m.group(1)))
+    return values
+
+
+def set_define(config, name, value):
+    """comment out the active #define name and put ours at the top"""
+    config = re.sub(r"^(\s*)(#define\s+" + name + r"\s)", r"\1//\2", config, flags=re.M)
+    guard = "#define CONFIG_H_\n"
+    return config.replace(guard, guard + "#define %s %d\n" % (name, value), 1)
+
+
+def find_prefix(prefix):
+    for p in ([prefix] if prefix else ["msp430-elf-", "msp430-"]):
+        if shutil.which(p + "gcc"):
+            return p
+    sys.exit("isr_budget.py: no msp430-gcc found, use --prefix")
+
+
+def build(args, prefix, config, f_cpu, baud, rxbuf):
+    """compile one config, return (asm text, text size, ram size) or an error string"""
+    with tempfile.TemporaryDirectory() as tmp:
+        for f in SOURCES:
+            shutil.copy(os.path.join(HERE, f), tmp)
+        cfg = config
+        for name, value in (("F_CPU", f_cpu), ("BAUD_RATE", baud), ("RX_BUFFER_SIZE", rxbuf)):
+            cfg = set_define(cfg, name, value)
+        with open(os.path.join(tmp, "config.h"), "w") as fh:
+            fh.write(cfg)
+
+        cc = [prefix + "gcc", "-mmcu=" + args.mmcu, "-Os", "-DSOFTSERIAL_ISR_CYCLES=1"] + args.cflags.split()
+        r = subprocess.run(cc + ["-S", "-o", "softserial.s", "softserial.c"],
+                           cwd=tmp, capture_output=True, text=True)
+        if r.returncode:
+            err = [m.group(1) for m in re.finditer(r"error: (?:#error )?(.*)", r.stderr)]
+            return (err[0] if err else "compile failed"), None, None
+        subprocess.run(cc + ["-c", "softserial.s"], cwd=tmp, check=True)
+        size = subprocess.run([prefix + "size", "softserial.o"], cwd=tmp,
+                              capture_output=True, text=True, check=True).stdout.splitlines()[1].split()
+        with open(os.path.join(tmp, "softserial.s")) as fh:
+            return fh.read(), int(size[0]), int(size[1]) + int(size[2])
+
+
+def analyze(text, loop_bound):
+    """worst case cycles of each ISR as (cycles, exact), entry and reti included"""
+    funcs, tables = parse_asm(text)
+    b = Budget(funcs, tables, loop_bound)
+    out = {}
+    for isr in ISRS:
+        c, exact = b.cost(isr)
+        out[isr] = (c + IRQ_ENTRY, exact) if isr in funcs else (0, False)
+    return out
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.split("\n")[1])
+    ap.add_argument("--cflags", default="", help="more compiler flags, e.g. the SOFTSERIAL_ features to check")
+    ap.add_argument("--mmcu", default="msp430g2553")
+    ap.add_argument("--prefix", default=None, help="toolchain prefix, msp430-elf- or msp430-")
+    ap.add_argument("--loop-bound", type=int, default=13, help="iterations counted for each loop (FRAME_BITS max)")
+    ap.add_argument("--asm", help="only analyze this msp430-gcc -S output, no build")
+    args = ap.parse_args()
+
+    if args.asm:
+        with open(args.asm) as fh:
+            for isr, (c, exact) in analyze(fh.read(), args.loop_bound).items():
+                print("%-20s %5d%s cycles" % (isr, c, "" if exact else "+"))
+        return 0
+
+    prefix = find_prefix(args.prefix)
+    with open(os.path.join(HERE, "config.h")) as fh:
+        config = fh.read()
+
+    print("%9s %7s %5s %6s %6s %6s %7s %9s %6s %5s" %
+          ("F_CPU", "BAUD", "RXBUF", "ticks", "TX", "RX", "duplex", "headroom", "flash", "RAM"))
+    failed = False
+    for f_cpu in listed(config, "F_CPU"):
+        for baud in listed(config, "BAUD_RATE"):
+            for rxbuf in listed(config, "RX_BUFFER_SIZE"):
+                ticks = (f_cpu + baud // 2) // baud
+                text, flash, ram = build(args, prefix, config, f_cpu, baud, rxbuf)
+                row = "%9d %7d %5d %6d" % (f_cpu, baud, rxbuf, ticks)
+                if flash is None:
+                    print("%s   rejected by softserial.c: %s" % (row, text))
+                    continue
+                isr = analyze(text, args.loop_bound)
+                tx, tx_exact = isr["SoftSerial_TX_ISR"]
+                rx, rx_exact = isr["SoftSerial_RX_ISR"]
+                duplex = tx + rx + IRQ_LATENCY
+                mark = "" if tx_exact and rx_exact else "+"
+                headroom = ticks - duplex
+                failed |= headroom < 0
+                print("%s %5d%1s %5d%1s %6d%1s %5d %2d%% %6d %5d%s" %
+                      (row, tx, "" if tx_exact else "+", rx, "" if rx_exact else "+",
+                       duplex, mark, headroom, 100 * headroom // ticks, flash, ram,
+                       "  OVER BUDGET" if headroom < 0 else ""))
+    return 1 if failed else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
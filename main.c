@@ -52,6 +52,8 @@
 #include <stdint.h>
 #include "config.h"
 #include "softserial.h"
+#include "softserial_print.h"
+#include "dco.h"
 
 #define SHOW_DCO_SETTINGS // spew the DCO settings at startup
 
@@ -64,6 +66,10 @@ int putchar(register int c)
     return 0;
 }
 
+#if defined(SOFTSERIAL_PRINT)
+#define print_hexb(c) SoftSerial_print_hex((c), 2)
+#define print(s) SoftSerial_print(s)
+#else
 /**
  * print_hexb() - print uint8_t as hex
  */
@@ -84,9 +90,6 @@ void print(const char *s)
         SoftSerial_xmit(*s++);
     } while (*s);
 }
-
-#if defined(CALIBRATE_DCO)
-void Set_DCO(unsigned int Delta); // use external 32.768k clock to calibrate and set F_CPU speed
 #endif
 
 /**
@@ -129,6 +132,10 @@ void setup()
     SoftSerial_init();              // Configure TIMERA and RX/TX pins
     __enable_interrupt();           // let the TIMERA do its work
 
+#if defined(RECALIBRATE_DCO)
+    DCO_track_start();              // keep the DCO on F_CPU as the temperature changes
+#endif
+
 #ifdef SHOW_DCO_SETTINGS
     print("\r\n>>Calibrated DCO values are:\r\n");
     print("BCSCTL1= 0x"); print_hexb(BCSCTL1); print("\r\n");
@@ -151,6 +158,10 @@ void loop()
 
     while (1) {
 
+#if defined(SOFTSERIAL_LOWPOWER)
+        SoftSerial_sleep();         // sleep until a byte arrives, see SoftSerial_wake_on()
+#endif
+
 #if 1 // use SoftSerial_read() it checks available() before continuing
         int c;
         if ( !SoftSerial_empty() ) {
@@ -184,41 +195,3 @@ void main(void)
         loop();
     }
 }
-
-#if defined(CALIBRATE_DCO)
-//--------------------------------------------------------------------------
-void Set_DCO(unsigned int Delta)            // Set DCO to F_CPU
-//--------------------------------------------------------------------------
-{
-    unsigned int Compare, Oldcapture = 0;
-
-    BCSCTL1 |= DIVA_3;                      // ACLK = LFXT1CLK/8
-    TACCTL0 = CM_1 | CCIS_1 | CAP;          // CAP, ACLK
-    TACTL = TASSEL_2 | MC_2 | TACLR;        // SMCLK, continuous mode, clear
-
-    while (1) {
-        while (!(CCIFG & TACCTL0));         // Wait until capture occurred
-        TACCTL0 &= ~CCIFG;                  // Capture occurred, clear flag
-        Compare = TACCR0;                   // Get current captured SMCLK
-        Compare = Compare - Oldcapture;     // SMCLK difference
-        Oldcapture = TACCR0;                // Save current captured SMCLK
-
-        if (Delta == Compare) break;        // If equal, leave "while(1)"
-        else if (Delta < Compare) {
-            DCOCTL--;                       // DCO is too fast, slow it down
-            if (DCOCTL == 0xFF)             // Did DCO roll under?
-            if (BCSCTL1 & 0x0f)
-                BCSCTL1--;                  // Select lower RSEL
-        }
-        else {
-            DCOCTL++;                       // DCO is too slow, speed it up
-            if (DCOCTL == 0x00)             // Did DCO roll over?
-            if ((BCSCTL1 & 0x0f) != 0x0f)
-                BCSCTL1++;                  // Select higher RSEL
-        }
-    }
-    TACCTL0 = 0;                            // Stop TACCR0
-    TACTL = 0;                              // Stop Timer_A
-    BCSCTL1 &= ~DIVA_3;                     // ACLK = LFXT1CLK
-}
-#endif
@@ -0,0 +1,215 @@
+/**
+ * msp430.h - stand-in for the compiler's msp430.h in the host simulator build
+ *
+ * The register names expand to the fields of the sim struct, see sim.h.
+ * Timer0_A, Port1 and the status register go through sim_reg16()/sim_reg8(),
+ * which let simulated time pass before the access. Timer1_A is plain
+ * memory because softserial_port.c takes the address of its registers.
+ * The chip is an msp430g2553, -DSIM_G2231 leaves out Timer0_A CCR2,
+ * Timer1_A3 and the USCI like on an msp430g2231.
+ *
+ * License: Do with this code what you want. However, don't blame
+ * me if you connect it to a heart pump and it stops.  This source
+ * is provided as is with no warranties. It probably has bugs!!
+ * You have been warned!
+ */
+
+#ifndef SIM_MSP430_H_
+#define SIM_MSP430_H_
+
+#include <stdint.h>
+#include "sim.h"
+
+#if !defined(SIM_G2231)
+#define __MSP430_HAS_TA3__
+#define __MSP430_HAS_T1A3__
+#define __MSP430_HAS_USCI__
+#endif
+
+#define BIT0 0x0001
+#define BIT1 0x0002
+#define BIT2 0x0004
+#define BIT3 0x0008
+#define BIT4 0x0010
+#define BIT5 0x0020
+#define BIT6 0x0040
+#define BIT7 0x0080
+
+//------------------------------------------------------------
+// status register and intrinsics
+//------------------------------------------------------------
+#define GIE    0x0008
+#define CPUOFF 0x0010
+#define OSCOFF 0x0020
+#define SCG0   0x0040
+#define SCG1   0x0080
+
+#define LPM0_bits (CPUOFF)
+#define LPM1_bits (SCG0 | CPUOFF)
+#define LPM3_bits (SCG1 | SCG0 | CPUOFF)
+#define LPM4_bits (SCG1 | SCG0 | OSCOFF | CPUOFF)
+
+#define __disable_interrupt()          sim_gie(0)
+#define __enable_interrupt()           sim_gie(1)
+#define __delay_cycles(n)              sim_delay(n)
+#define __no_operation()               sim_delay(1)
+#define __bis_SR_register(x)           sim_bis_sr(x)
+#define __bic_SR_register_on_exit(x)   sim_bic_sr_on_exit(x)
+
+//------------------------------------------------------------
+// Timer_A
+//------------------------------------------------------------
+#define TASSEL_1 0x0100
+#define TASSEL_2 0x0200
+#define MC_0     0x0000
+#define MC_1     0x0010
+#define MC_2     0x0020
+#define MC_3     0x0030
+#define TACLR    0x0004
+#define TAIE     0x0002
+#define TAIFG    0x0001
+
+#define CM0      0x4000
+#define CM1      0x8000
+#define CM_0     0x0000
+#define CM_1     0x4000
+#define CM_2     0x8000
+#define CM_3     0xC000
+#define CCIS0    0x1000
+#define CCIS1    0x2000
+#define CCIS_0   0x0000
+#define CCIS_1   0x1000
+#define CCIS_2   0x2000
+#define CCIS_3   0x3000
+#define SCS      0x0800
+#define SCCI     0x0400
+#define CAP      0x0100
+#define OUTMOD0  0x0020
+#define OUTMOD1  0x0040
+#define OUTMOD2  0x0080
+#define CCIE     0x0010
+#define CCI      0x0008
+#define OUT      0x0004
+#define COV      0x0002
+#define CCIFG    0x0001
+
+#define TA0CTL   (*sim_reg16(&sim.ta[0].ctl))
+#define TA0R     (*sim_reg16(&sim.ta[0].r))
+#define TA0CCTL0 (*sim_reg16(&sim.ta[0].cctl[0]))
+#define TA0CCTL1 (*sim_reg16(&sim.ta[0].cctl[1]))
+#define TA0CCR0  (*sim_reg16(&sim.ta[0].ccr[0]))
+#define TA0CCR1  (*sim_reg16(&sim.ta[0].ccr[1]))
+#define TA0IV    sim_taiv(0)
+#if defined(__MSP430_HAS_TA3__)
+#define TA0CCTL2 (*sim_reg16(&sim.ta[0].cctl[2]))
+#define TA0CCR2  (*sim_reg16(&sim.ta[0].ccr[2]))
+#endif
+
+#define TACTL    TA0CTL
+#define TAR      TA0R
+#define TACCTL0  TA0CCTL0
+#define TACCTL1  TA0CCTL1
+#define TACCR0   TA0CCR0
+#define TACCR1   TA0CCR1
+#define TAIV     TA0IV
+
+#if defined(__MSP430_HAS_T1A3__)
+#define TA1CTL   (*sim_reg16(&sim.ta[1].ctl))
+#define TA1R     (*sim_reg16(&sim.ta[1].r))
+#define TA1CCTL0 (sim.ta[1].cctl[0])
+#define TA1CCTL1 (sim.ta[1].cctl[1])
+#define TA1CCTL2 (sim.ta[1].cctl[2])
+#define TA1CCR0  (sim.ta[1].ccr[0])
+#define TA1CCR1  (sim.ta[1].ccr[1])
+#define TA1CCR2  (sim.ta[1].ccr[2])
+#define TA1IV    sim_taiv(1)
+#endif
+
+//------------------------------------------------------------
+// Port1, Port2
+//------------------------------------------------------------
+#define P1IN   (*sim_reg8(&sim.port[0].in))
+#define P1OUT  (*sim_reg8(&sim.port[0].out))
+#define P1DIR  (*sim_reg8(&sim.port[0].dir))
+#define P1SEL  (*sim_reg8(&sim.port[0].sel))
+#define P1SEL2 (*sim_reg8(&sim.port[0].sel2))
+#define P1REN  (*sim_reg8(&sim.port[0].ren))
+#define P1IES  (*sim_reg8(&sim.port[0].ies))
+#define P1IE   (*sim_reg8(&sim.port[0].ie))
+#define P1IFG  (*sim_reg8(&sim.port[0].ifg))
+
+#define P2IN   (*sim_reg8(&sim.port[1].in))
+#define P2OUT  (*sim_reg8(&sim.port[1].out))
+#define P2DIR  (*sim_reg8(&sim.port[1].dir))
+#define P2SEL  (*sim_reg8(&sim.port[1].sel))
+#define P2SEL2 (*sim_reg8(&sim.port[1].sel2))
+#define P2REN  (*sim_reg8(&sim.port[1].ren))
+#define P2IES  (*sim_reg8(&sim.port[1].ies))
+#define P2IE   (*sim_reg8(&sim.port[1].ie))
+#define P2IFG  (*sim_reg8(&sim.port[1].ifg))
+
+//------------------------------------------------------------
+// WDT, special function and clock registers
+//------------------------------------------------------------
+#define WDTPW    0x5A00
+#define WDTHOLD  0x0080
+#define WDTNMI   0x0020
+#define WDTTMSEL 0x0010
+#define WDTCNTCL 0x0008
+#define WDTSSEL  0x0004
+#define WDTIS1   0x0002
+#define WDTIS0   0x0001
+#define WDT_ADLY_1_9 (WDTPW + WDTTMSEL + WDTCNTCL + WDTSSEL + WDTIS1 + WDTIS0)
+
+#define WDTIE    0x01
+#define WDTIFG   0x01
+
+#define DIVA_3   0x30
+#define XCAP_0   0x00
+#define XCAP_3   0x0C
+
+#define WDTCTL   (*sim_reg16(&sim.wdtctl))
+#define IE1      (*sim_reg8(&sim.ie1))
+#define IFG1     (*sim_reg8(&sim.ifg1))
+#define IE2      (*sim_reg8(&sim.ie2))
+#define IFG2     (*sim_reg8(&sim.ifg2))
+#define DCOCTL   (*sim_reg8(&sim.dcoctl))
+#define BCSCTL1  (*sim_reg8(&sim.bcsctl1))
+#define BCSCTL3  (*sim_reg8(&sim.bcsctl3))
+
+//------------------------------------------------------------
+// USCI_A0, UART mode
+//------------------------------------------------------------
+#if defined(__MSP430_HAS_USCI__)
+#define UCPEN    0x80
+#define UCPAR    0x40
+#define UC7BIT   0x10
+#define UCSPB    0x08
+#define UCMODE_2 0x04
+#define UCSSEL_2 0x80
+#define UCRXEIE  0x20
+#define UCTXADDR 0x04
+#define UCSWRST  0x01
+#define UCFE     0x40
+#define UCOE     0x20
+#define UCPE     0x10
+#define UCADDR   0x02
+#define UCBUSY   0x01
+#define UCBRS0   0x02
+
+#define UCA0RXIE  0x01
+#define UCA0TXIE  0x02
+#define UCA0RXIFG 0x01
+#define UCA0TXIFG 0x02
+
+#define UCA0CTL0  (*sim_reg8(&sim.uca0ctl0))
+#define UCA0CTL1  (*sim_reg8(&sim.uca0ctl1))
+#define UCA0BR0   (*sim_reg8(&sim.uca0br0))
+#define UCA0BR1   (*sim_reg8(&sim.uca0br1))
+#define UCA0MCTL  (*sim_reg8(&sim.uca0mctl))
+#define UCA0STAT  (*sim_reg8(&sim.uca0stat))
+#define UCA0TXBUF (*sim_reg8(&sim.uca0txbuf))
+#define UCA0RXBUF (*sim_reg8(&sim.uca0rxbuf))
+#endif
+
+#endif /*SIM_MSP430_H_*/
@@ -0,0 +1,205 @@
+#!/usr/bin/env python3
+"""
+run_tests.py - test_softserial for every rate in config.h and every feature config below
+
+Builds softserial.c with the host gcc against the simulator in this
+directory, once for each F_CPU and BAUD_RATE listed in config.h,
+commented out or not, times each entry of CONFIGS. A rate softserial.c
+refuses with #error is skipped, except for configs that are expected
+to be refused, those fail when one builds. Then it runs the tests of
+every build that compiled:
+
+    ./run_tests.py
+    ./run_tests.py -k vote -v
+    ./run_tests.py --cflags "-DSOFTSERIAL_TX_EDGES"
+
+The exit code is 1 if any test failed or a build broke.
+
+License: Do with this code what you want. However, don't blame
+me if you connect it to a heart pump and it stops.  This source
+is provided as is with no warranties. It probably has bugs!!
+You have been warned!
+"""
+
+import argparse
+import concurrent.futures
+import os
+import re
+import shutil
+import subprocess
+import sys
+import tempfile
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+ROOT = os.path.dirname(HERE)
+SOURCES = ["softserial.c", "softserial.h", "softserial_port.c", "softserial_port.h",
+           "softserial_print.c", "softserial_print.h", "dco.c", "dco.h", "config.h"]
+TESTS = "test_softserial.c"
+
+RUN = "run"             # build it and run the tests where the rate is accepted
+COMPILE = "compile"     # the simulator doesn't model it, only has to build
+REJECT = "reject"       # softserial.c has to refuse it with #error at every rate
+
+# name, what to do, defines. -DNAME=n of a name config.h defines replaces it there
+CONFIGS = [
+    ("8N1",             RUN,     ""),
+    ("stats",           RUN,     "-DSOFTSERIAL_STATS"),
+    ("tx_edges",        RUN,     "-DSOFTSERIAL_TX_EDGES -DSOFTSERIAL_STATS"),
+    ("rx_edges",        RUN,     "-DSOFTSERIAL_RX_EDGES -DSOFTSERIAL_STATS"),
+    ("rx_vote",         RUN,     "-DSOFTSERIAL_RX_VOTE -DSOFTSERIAL_STATS"),
+    ("rx_edges_vote",   RUN,     "-DSOFTSERIAL_RX_EDGES -DSOFTSERIAL_RX_VOTE"),
+    ("7E1",             RUN,     "-DSOFTSERIAL_DATA_BITS=7 -DSOFTSERIAL_PARITY=\\'E\\' -DSOFTSERIAL_STATS"),
+    ("8E1",             RUN,     "-DSOFTSERIAL_PARITY=\\'E\\'"),
+    ("7O2",             RUN,     "-DSOFTSERIAL_DATA_BITS=7 -DSOFTSERIAL_PARITY=\\'O\\' -DSOFTSERIAL_STOP_BITS=2"),
+    ("9N1",             RUN,     "-DSOFTSERIAL_DATA_BITS=9 -DSOFTSERIAL_RX_EDGES"),
+    ("runtime_baud",    RUN,     "-DSOFTSERIAL_RUNTIME_BAUD -DSOFTSERIAL_TX_EDGES"),
+    ("runtime_bits",    RUN,     "-DSOFTSERIAL_RUNTIME_BAUD -DSOFTSERIAL_STATS"),
+    ("break",           RUN,     "-DSOFTSERIAL_BREAK -DSOFTSERIAL_STATS"),
+    ("break_edges",     RUN,     "-DSOFTSERIAL_BREAK -DSOFTSERIAL_RX_EDGES"),
+    ("break_g2231",     RUN,     "-DSOFTSERIAL_BREAK -DSIM_G2231"),
+    ("timers",          RUN,     "-DSOFTSERIAL_TIMERS=2 -DSOFTSERIAL_STATS"),
+    ("timers_edges",    RUN,     "-DSOFTSERIAL_TIMERS=2 -DSOFTSERIAL_RX_EDGES"),
+    ("break_timers",    RUN,     "-DSOFTSERIAL_BREAK -DSOFTSERIAL_TIMERS=2 -DSIM_G2231"),
+    ("ports",           RUN,     "-DSOFTSERIAL_PORTS"),
+    ("bridge",          RUN,     "-DSOFTSERIAL_BRIDGE -DSOFTSERIAL_STATS"),
+    ("ports_bridge",    RUN,     "-DSOFTSERIAL_PORTS -DSOFTSERIAL_BRIDGE -DSOFTSERIAL_STATS"),
+    ("rtscts",          RUN,     "-DSOFTSERIAL_RTSCTS -DSOFTSERIAL_STATS"),
+    ("xonxoff",         RUN,     "-DSOFTSERIAL_XONXOFF"),
+    ("rs485",           RUN,     "-DSOFTSERIAL_RS485 -DSOFTSERIAL_DATA_BITS=9 -DSOFTSERIAL_RX_EDGES"),
+    ("rs485_edges",     RUN,     "-DSOFTSERIAL_RS485 -DSOFTSERIAL_TX_EDGES -DSOFTSERIAL_STATS"),
+    ("rs485_gap",       RUN,     "-DSOFTSERIAL_RS485 -DSOFTSERIAL_FRAMING=\\'G\\'"),
+    ("receive_into",    RUN,     "-DSOFTSERIAL_RECEIVE -DSOFTSERIAL_RX_EDGES"),
+    ("receive_timers",  RUN,     "-DSOFTSERIAL_RECEIVE -DSOFTSERIAL_TIMERS=1 -DSOFTSERIAL_STATS"),
+    ("cobs",            RUN,     "-DSOFTSERIAL_FRAMING=\\'C\\' -DRX_BUFFER_SIZE=256 -DSOFTSERIAL_STATS"),
+    ("slip",            RUN,     "-DSOFTSERIAL_FRAMING=\\'S\\' -DSOFTSERIAL_STATS"),
+    ("stamps",          RUN,     "-DSOFTSERIAL_STAMPS -DSOFTSERIAL_STATS"),
+    ("stamps_edges",    RUN,     "-DSOFTSERIAL_STAMPS -DSOFTSERIAL_RX_EDGES"),
+    ("print",           RUN,     "-DSOFTSERIAL_PRINT -DSOFTSERIAL_TX_EDGES"),
+    ("print_7E1",       RUN,     "-DSOFTSERIAL_PRINT -DSOFTSERIAL_DATA_BITS=7 -DSOFTSERIAL_PARITY=\\'E\\'"),
+    ("lpm3_gap",        RUN,     "-DSOFTSERIAL_LOWPOWER -DSOFTSERIAL_LPM3 -DSOFTSERIAL_FRAMING=\\'G\\'"),
+    ("lpm3_idle",       RUN,     "-DSOFTSERIAL_LOWPOWER -DSOFTSERIAL_LPM3 -DSOFTSERIAL_BREAK"),
+    ("lpm3_ports",      REJECT,  "-DSOFTSERIAL_LOWPOWER -DSOFTSERIAL_LPM3 -DSOFTSERIAL_PORTS"),
+    ("dco_track",       RUN,     "-DRECALIBRATE_DCO -DSOFTSERIAL_RX_EDGES"),
+    ("usci",            COMPILE, "-DSOFTSERIAL_USCI -DSOFTSERIAL_DATA_BITS=7 -DSOFTSERIAL_PARITY=\\'E\\'"),
+    ("usci_8E1",        COMPILE, "-DSOFTSERIAL_USCI -DSOFTSERIAL_PARITY=\\'E\\'"),
+    ("usci_runtime",    COMPILE, "-DSOFTSERIAL_USCI -DSOFTSERIAL_RUNTIME_BAUD"),
+]
+
+
+def listed(config, name):
+    """every value config.h has for name, commented out or not, in file order"""
+    values = []
+    for m in re.finditer(r"^\s*(?://)?\s*#define\s+" + name + r"\s+(\d+)", config, re.M):
+        if int(m.group(1)) not in values:
+            values.append(int(m.group(1)))
+    return values
+
+
+def set_define(config, name, value):
+    """comment out the active #define name and put ours at the top"""
+    config = re.sub(r"^(\s*)(#define\s+" + name + r"\s)", r"\1//\2", config, flags=re.M)
+    guard = "#define CONFIG_H_\n"
+    return config.replace(guard, guard + "#define %s %d\n" % (name, value), 1)
+
+
+def build(config, f_cpu, baud, cflags, tmp, sim_o):
+    """compile one config into tmp, return (binary, None), (None, #error text) or (None, None) if it broke"""
+    for f in SOURCES:
+        shutil.copy(os.path.join(ROOT, f), tmp)
+    cfg = config
+    for name, value in (("F_CPU", f_cpu), ("BAUD_RATE", baud)):
+        cfg = set_define(cfg, name, value)
+    for m in re.finditer(r"-D(\w+)=(\d+)", cflags):
+        if re.search(r"^\s*#define\s+" + m.group(1) + r"\s", cfg, re.M):
+            cfg = set_define(cfg, m.group(1), int(m.group(2)))   # config.h has it, ours goes in there
+            cflags = cflags.replace(m.group(0), "")
+    with open(os.path.join(tmp, "config.h"), "w") as fh:
+        fh.write(cfg)
+
+    exe = os.path.join(tmp, "test_softserial")
+    cc = ("gcc -O1 -Wall -Wextra -Wno-missing-field-initializers -Werror -I %s -I %s '-DSOFTSERIAL_ISR(vec,name)=void name(void)' %s -o %s %s %s"
+          % (tmp, HERE, cflags, exe,
+             sim_o + " " + os.path.join(HERE, TESTS),
+             " ".join(os.path.join(tmp, f) for f in SOURCES if f.endswith(".c"))))
+    r = subprocess.run(cc, shell=True, capture_output=True, text=True)
+    if r.returncode:
+        err = [m.group(1) for m in re.finditer(r"error: #error (.*)", r.stderr)]
+        if err:
+            return None, err[0]
+        sys.stdout.write(r.stderr)
+        return None, None
+    return exe, None
+
+
+def one(config, f_cpu, baud, name, what, cflags, pattern, sim_o):
+    """build and run one config, return (ok, report line, test output), ok is None if the rate was refused"""
+    row = "%9d %7d  %-15s" % (f_cpu, baud, name)
+    with tempfile.TemporaryDirectory() as tmp:
+        exe, err = build(config, f_cpu, baud, cflags, tmp, sim_o)
+        if what == REJECT:
+            if exe:
+                return False, row + " built, should be rejected", ""
+            return err is not None, row + " rejected: " + str(err), ""
+        if not exe:
+            if err is None:
+                return False, row + " does not build", ""
+            return None, row + " rejected by softserial.c: " + err, ""
+        if what == COMPILE:
+            return True, row + " compiles", ""
+        r = subprocess.run([exe] + ([pattern] if pattern else []), capture_output=True, text=True)
+        return r.returncode == 0, row + (" ok" if r.returncode == 0 else " FAILED"), r.stdout + r.stderr
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.split("\n")[1])
+    ap.add_argument("-k", dest="only", default="", help="only configs with this in the name")
+    ap.add_argument("-t", dest="tests", default="", help="only tests with this in the name")
+    ap.add_argument("-v", dest="verbose", action="store_true", help="show the test output of every build")
+    ap.add_argument("-j", dest="jobs", type=int, default=os.cpu_count(), help="builds running at once")
+    ap.add_argument("--cflags", default="", help="more defines for every config")
+    args = ap.parse_args()
+
+    sys.stdout.reconfigure(line_buffering=True)
+    if not shutil.which("gcc"):
+        sys.exit("run_tests.py: needs a host gcc")
+    with open(os.path.join(ROOT, "config.h")) as fh:
+        config = fh.read()
+
+    objdir = tempfile.TemporaryDirectory()
+    sim_o = os.path.join(objdir.name, "sim.o")   # the same for every config
+    subprocess.run(["gcc", "-O1", "-Wall", "-Wextra", "-Werror", "-I", HERE, "-c", "-o", sim_o,
+                    os.path.join(HERE, "sim.c")], check=True)
+
+    jobs = []
+    for name, what, cflags in CONFIGS:
+        if args.only not in name:
+            continue
+        for f_cpu in listed(config, "F_CPU"):
+            for baud in listed(config, "BAUD_RATE"):
+                jobs.append((config, f_cpu, baud, name, what, cflags + " " + args.cflags, args.tests, sim_o))
+
+    failed = 0
+    ran = {}
+    with concurrent.futures.ThreadPoolExecutor(args.jobs) as pool:
+        for job, (ok, line, out) in zip(jobs, pool.map(lambda j: one(*j), jobs)):
+            ran.setdefault(job[3], 0)
+            if ok is None:
+                if args.verbose:
+                    print(line)
+                continue
+            ran[job[3]] += 1
+            failed += not ok
+            print(line)
+            if out and (args.verbose or not ok):
+                print(out.rstrip())
+
+    for name, n in ran.items():
+        if not n:
+            print("%-15s every rate was rejected, nothing ran" % name)
+            failed += 1
+    print("%d builds, %d failed" % (sum(ran.values()), failed))
+    return 1 if failed else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,688 @@
+/**
+ * sim.c - host simulator of the msp430g2553 parts softserial uses, see sim.h
+ *
+ * Everything happens in tick(), one SMCLK period: the generator and the
+ * wires move the input pins, the timers count, capture and compare, the
+ * output units move the output pins, and the interrupt flags go up.
+ * step() is a tick plus taking pending interrupts, in priority order,
+ * when GIE is set and no ISR is running. The ISRs are looked up as weak
+ * symbols, so a build without softserial_port.c or dco.c links too.
+ *
+ * License: Do with this code what you want. However, don't blame
+ * me if you connect it to a heart pump and it stops.  This source
+ * is provided as is with no warranties. It probably has bugs!!
+ * You have been warned!
+ */
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "msp430.h"
+#include "sim.h"
+
+#define SIM_EVENTS_MAX 65536    // generator pin changes waiting to happen
+#define SIM_WIRES_MAX  8
+
+/**
+ * ISRs, whichever of them the build has
+ */
+extern void SoftSerial_TX_ISR(void) __attribute__((weak));
+extern void SoftSerial_RX_ISR(void) __attribute__((weak));
+extern void SoftSerial_wake_ISR(void) __attribute__((weak));
+extern void SoftSerial_CTS_ISR(void) __attribute__((weak));
+extern void SoftSerial_port_CCR0_ISR(void) __attribute__((weak));
+extern void SoftSerial_port_TAIV_ISR(void) __attribute__((weak));
+extern void DCO_track_ISR(void) __attribute__((weak));
+
+typedef void (*isr_t)(void);
+
+/**
+ * typedef event_t - a pin change the generator scheduled
+ */
+typedef struct {
+    uint64_t t;
+    uint16_t pin;
+    uint8_t level;
+} event_t;
+
+//--------------------------------------------------------------------------------
+// F I L E   G L O B A L S
+//--------------------------------------------------------------------------------
+
+sim_t sim;
+sim_trace_t sim_traced;
+
+/**
+ * Which pins the timer output units drive and the capture inputs listen to.
+ * 0 is no pin. CCISx A and B, GND and VCC are handled in tick().
+ */
+static const uint16_t out_pin[2][3] = {
+    { SIM_P1(BIT1), SIM_P1(BIT2), 0 },
+    { SIM_P2(BIT0), SIM_P2(BIT1), SIM_P2(BIT4) }
+};
+static const uint16_t cci_pin[2][3][2] = {
+    { { SIM_P1(BIT1), 0 }, { SIM_P1(BIT2), 0 }, { 0, 0 } },
+    { { SIM_P2(BIT0), SIM_P2(BIT3) }, { SIM_P2(BIT1), SIM_P2(BIT2) }, { SIM_P2(BIT4), SIM_P2(BIT5) } }
+};
+
+static event_t events[SIM_EVENTS_MAX];
+static unsigned ev_first, ev_last;
+
+static uint16_t wire_from[SIM_WIRES_MAX];
+static uint16_t wire_to[SIM_WIRES_MAX];
+static unsigned wires;
+
+static uint16_t trace_pin;
+static uint8_t trace_level;
+static uint8_t prev_in[2];      // port levels last tick, for the port interrupt edges
+static uint64_t wdt_due;
+
+static void step(void);
+
+//--------------------------------------------------------------------------------
+// P I N S
+//--------------------------------------------------------------------------------
+
+static sim_port_t *pin_port(unsigned pin)
+{
+    return &sim.port[(pin >> 8) - 1];
+}
+
+/**
+ * pin_level() - what is on the pin, our output if we drive it, else the outside
+ */
+
+static unsigned pin_level(unsigned pin)
+{
+    sim_port_t *p = pin_port(pin);
+    uint8_t m = pin;
+    unsigned t, i;
+
+    if (p->dir & m) {
+        if (p->sel & m) {
+            for (t = 0; t < 2; ++t) {
+                for (i = 0; i < 3; ++i) {
+                    if (out_pin[t][i] == pin) {
+                        return sim.ta[t].out[i];
+                    }
+                }
+            }
+        }
+        return (p->out & m) != 0;
+    }
+    return (p->ext & m) != 0;
+}
+
+static void set_ext(unsigned pin, unsigned level)
+{
+    sim_port_t *p = pin_port(pin);
+
+    if (level) {
+        p->ext |= (uint8_t)pin;
+    }
+    else {
+        p->ext &= ~(uint8_t)pin;
+    }
+}
+
+/**
+ * update_pins() - follow the wires, refresh PxIN and the trace
+ */
+
+static void update_pins(void)
+{
+    unsigned n, b;
+
+    for (n = 0; n < wires; ++n) {
+        set_ext(wire_to[n], pin_level(wire_from[n]));
+    }
+    for (n = 0; n < 2; ++n) {
+        uint8_t in = 0;
+
+        for (b = 0; b < 8; ++b) {
+            if (pin_level(((n + 1) << 8) | (1 << b))) {
+                in |= 1 << b;
+            }
+        }
+        sim.port[n].in = in;
+    }
+    if (trace_pin && pin_level(trace_pin) != trace_level) {
+        trace_level = !trace_level;
+        if (sim_traced.n < SIM_TRACE_MAX) {
+            sim_traced.t[sim_traced.n] = sim.now;
+            sim_traced.level[sim_traced.n] = trace_level;
+            ++sim_traced.n;
+        }
+    }
+}
+
+/**
+ * port_edges() - PxIFG on the edge PxIES selects, GPIO pins only
+ */
+
+static void port_edges(void)
+{
+    unsigned n;
+
+    for (n = 0; n < 2; ++n) {
+        sim_port_t *p = &sim.port[n];
+        uint8_t rise = p->in & ~prev_in[n];
+        uint8_t fall = ~p->in & prev_in[n];
+
+        p->ifg |= ((rise & ~p->ies) | (fall & p->ies)) & ~p->sel;
+        prev_in[n] = p->in;
+    }
+}
+
+//--------------------------------------------------------------------------------
+// T I M E R S
+//--------------------------------------------------------------------------------
+
+/**
+ * output_unit() - OUTx on EQUx, continuous mode
+ */
+
+static void output_unit(sim_timer_t *t, unsigned i)
+{
+    switch ((t->cctl[i] >> 5) & 7) {
+    case 0:
+        break;
+    case 1:                             // set
+        t->out[i] = 1;
+        break;
+    case 4:                             // toggle
+        t->out[i] ^= 1;
+        break;
+    case 5:                             // reset
+        t->out[i] = 0;
+        break;
+    default:
+        sim_fail("OUTMOD %u is not simulated", (t->cctl[i] >> 5) & 7);
+    }
+}
+
+/**
+ * timer_tick() - count, capture and compare one SMCLK tick
+ */
+
+static void timer_tick(unsigned n)
+{
+    sim_timer_t *t = &sim.ta[n];
+    unsigned run, i;
+
+    if (t->ctl & TACLR) {
+        t->r = 0;
+        t->ctl &= ~TACLR;
+    }
+    run = (t->ctl & MC_3) == MC_2 && !(sim.sr & SCG1);
+    if (run) {
+        ++t->r;
+    }
+
+    for (i = 0; i < 3; ++i) {
+        uint16_t cctl = t->cctl[i];
+        unsigned ccis = (cctl >> 12) & 3;
+        unsigned prev = t->cci[i];
+        unsigned in = prev;
+
+        if (ccis == 2) {
+            in = 0;
+        }
+        else if (ccis == 3) {
+            in = 1;
+        }
+        else if (!cci_pin[n][i][ccis]) {
+            in = 0;
+        }
+        else if (pin_port(cci_pin[n][i][ccis])->sel & (uint8_t)cci_pin[n][i][ccis]) {
+            in = pin_level(cci_pin[n][i][ccis]);
+        }
+        t->cci[i] = in;
+
+        if (run) {
+            if (cctl & CAP) {
+                if ((in && !prev && (cctl & CM0)) || (!in && prev && (cctl & CM1))) {
+                    t->ccr[i] = t->r;
+                    if (cctl & CCIFG) {
+                        cctl |= COV;
+                    }
+                    cctl |= CCIFG;
+                }
+            }
+            else if (t->r == t->ccr[i]) {
+                cctl |= CCIFG;
+                t->scci[i] = in;
+                t->cctl[i] = cctl;
+                output_unit(t, i);
+                if (!t->equ_count[i]++) {
+                    t->equ_first[i] = sim.now;
+                }
+            }
+        }
+        if (!(cctl & (OUTMOD2 | OUTMOD1 | OUTMOD0))) {
+            t->out[i] = (cctl & OUT) != 0;
+        }
+        cctl &= ~(CCI | SCCI);
+        if (t->cci[i]) {
+            cctl |= CCI;
+        }
+        if (t->scci[i]) {
+            cctl |= SCCI;
+        }
+        t->cctl[i] = cctl;
+    }
+}
+
+/**
+ * wdt_interval() - ticks between WDT interval interrupts
+ */
+
+static uint64_t wdt_interval(void)
+{
+    static const uint32_t div[4] = { 32768, 8192, 512, 64 };
+    uint64_t ticks = div[sim.wdtctl & (WDTIS1 | WDTIS0)];
+
+    if (sim.wdtctl & WDTSSEL) {
+        ticks = ticks * sim.f_cpu / 32768;  // ACLK from the watch crystal
+    }
+    return ticks;
+}
+
+static void wdt_tick(void)
+{
+    if (sim.wdtctl & WDTCNTCL) {
+        sim.wdtctl &= ~WDTCNTCL;
+        wdt_due = sim.now + wdt_interval();
+    }
+    if (!(sim.wdtctl & WDTHOLD) && (sim.wdtctl & WDTTMSEL) && sim.now >= wdt_due) {
+        sim.ifg1 |= WDTIFG;
+        wdt_due += wdt_interval();
+    }
+}
+
+//--------------------------------------------------------------------------------
+// C L O C K   A N D   I N T E R R U P T S
+//--------------------------------------------------------------------------------
+
+/**
+ * tick() - one SMCLK period
+ */
+
+static void tick(void)
+{
+    if (++sim.now > sim.deadline) {
+        sim_fail("timed out at tick %llu", (unsigned long long)sim.now);
+    }
+
+    while (ev_first != ev_last && events[ev_first].t <= sim.now) {
+        set_ext(events[ev_first].pin, events[ev_first].level);
+        ++ev_first;
+    }
+    update_pins();
+
+    timer_tick(0);
+    timer_tick(1);
+    wdt_tick();
+
+    update_pins();
+    port_edges();
+}
+
+/**
+ * run_isr() - interrupt entry, the handler, reti
+ *
+ * Entry clears SR except SCG0, so an ISR always runs with SMCLK on.
+ */
+
+static void run_isr(isr_t fn)
+{
+    unsigned k;
+
+    sim.sr_isr = sim.sr;
+    sim.sr &= SCG0;
+    sim.in_isr = 1;
+    for (k = SIM_IRQ_ENTRY; k; --k) {
+        tick();
+    }
+    fn();
+    for (k = SIM_IRQ_RETI; k; --k) {
+        tick();
+    }
+    sim.in_isr = 0;
+    sim.sr = sim.sr_isr;
+}
+
+static unsigned pending(volatile uint16_t cctl)
+{
+    return (cctl & (CCIE | CCIFG)) == (CCIE | CCIFG);
+}
+
+static isr_t need(isr_t fn, const char *name)
+{
+    if (!fn) {
+        sim_fail("%s is pending but the build has no handler for it", name);
+    }
+    return fn;
+}
+
+/**
+ * next_irq() - the highest priority pending interrupt, flags that clear on entry are cleared
+ */
+
+static isr_t next_irq(void)
+{
+    if (pending(sim.ta[1].cctl[0])) {
+        sim.ta[1].cctl[0] &= ~CCIFG;
+        return need(SoftSerial_port_CCR0_ISR, "TIMER1_A0");
+    }
+    if (pending(sim.ta[1].cctl[1]) || pending(sim.ta[1].cctl[2])) {
+        return need(SoftSerial_port_TAIV_ISR, "TIMER1_A1");
+    }
+    if (sim.ie1 & sim.ifg1 & WDTIFG) {
+        sim.ifg1 &= ~WDTIFG;
+        return need(DCO_track_ISR, "WDT");
+    }
+    if (pending(sim.ta[0].cctl[0])) {
+        sim.ta[0].cctl[0] &= ~CCIFG;
+        return need(SoftSerial_TX_ISR, "TIMER0_A0");
+    }
+    if (pending(sim.ta[0].cctl[1]) || pending(sim.ta[0].cctl[2])) {
+        return need(SoftSerial_RX_ISR, "TIMER0_A1");
+    }
+    if (sim.port[0].ie & sim.port[0].ifg) {
+        return need(SoftSerial_wake_ISR ? SoftSerial_wake_ISR : SoftSerial_CTS_ISR, "PORT1");
+    }
+    return 0;
+}
+
+static void irq(void)
+{
+    while (!sim.in_isr && (sim.sr & GIE)) {
+        isr_t fn = next_irq();
+
+        if (!fn) {
+            break;
+        }
+        run_isr(fn);
+    }
+}
+
+static void step(void)
+{
+    tick();
+    irq();
+}
+
+//--------------------------------------------------------------------------------
+// E X P O S E D   E X T E R N A L   F U N C T I O N S
+//--------------------------------------------------------------------------------
+
+/**
+ * sim_reset() - power up, SMCLK at f_cpu. The watchdog starts held, nothing is wired.
+ */
+
+void sim_reset(unsigned long f_cpu)
+{
+    memset(&sim, 0, sizeof(sim));
+    sim.f_cpu = f_cpu;
+    sim.deadline = UINT64_MAX;
+    sim.wdtctl = WDTHOLD;
+    sim.dcoctl = 0x60;
+    sim.bcsctl1 = 0x87;
+    sim.port[0].ext = sim.port[1].ext = 0xFF;   // idle lines are high
+    sim.ifg2 = 0x02;                            // UCA0TXIFG, UCA0TXBUF is empty
+
+    ev_first = ev_last = 0;
+    wires = 0;
+    trace_pin = 0;
+    wdt_due = 0;
+    update_pins();
+    prev_in[0] = sim.port[0].in;
+    prev_in[1] = sim.port[1].in;
+}
+
+/**
+ * sim_run() - let ticks go by, the ISRs run
+ *
+ * An ISR taken on the last tick may run past the end.
+ */
+
+void sim_run(uint32_t ticks)
+{
+    uint64_t end = sim.now + ticks;
+
+    while (sim.now < end) {
+        step();
+    }
+}
+
+/**
+ * sim_deadline() - sim_fail() if the test is still running ticks from now
+ */
+
+void sim_deadline(uint32_t ticks)
+{
+    sim.deadline = sim.now + ticks;
+}
+
+/**
+ * sim_fail() - report and exit, each test runs in its own process
+ */
+
+void sim_fail(const char *fmt, ...)
+{
+    va_list ap;
+
+    printf("    FAIL: ");
+    va_start(ap, fmt);
+    vprintf(fmt, ap);
+    va_end(ap);
+    printf("\n");
+    fflush(stdout);
+    exit(1);
+}
+
+/**
+ * sim_wire() - the outside of pin to follows pin from, one tick later
+ */
+
+void sim_wire(unsigned from, unsigned to)
+{
+    if (wires == SIM_WIRES_MAX) {
+        sim_fail("too many wires");
+    }
+    wire_from[wires] = from;
+    wire_to[wires] = to;
+    ++wires;
+}
+
+/**
+ * sim_drive() - the outside drives pin to level from now on
+ */
+
+void sim_drive(unsigned pin, unsigned level)
+{
+    set_ext(pin, level);
+    update_pins();
+}
+
+/**
+ * sim_level() - the level on a pin right now
+ */
+
+unsigned sim_level(unsigned pin)
+{
+    return pin_level(pin);
+}
+
+/**
+ * sim_trace() - record every change of pin from now on in sim_traced
+ */
+
+void sim_trace(unsigned pin)
+{
+    trace_pin = pin;
+    trace_level = pin_level(pin);
+    sim_traced.n = 0;
+}
+
+/**
+ * sim_gen_start() - drive pin with bits of x16 ticks (16.16) each, starting delay ticks from now
+ */
+
+void sim_gen_start(sim_gen_t *g, unsigned pin, uint32_t x16, uint32_t delay)
+{
+    g->pin = pin;
+    g->x16 = x16;
+    g->t16 = (sim.now + delay) << 16;
+    g->level = pin_level(pin);
+}
+
+static void gen_level(sim_gen_t *g, unsigned level)
+{
+    unsigned i;
+
+    if (level == g->level) {
+        return;
+    }
+    g->level = level;
+
+    if (ev_last == SIM_EVENTS_MAX) {
+        memmove(events, &events[ev_first], (ev_last - ev_first) * sizeof(event_t));
+        ev_last -= ev_first;
+        ev_first = 0;
+        if (ev_last == SIM_EVENTS_MAX) {
+            sim_fail("generator queue is full");
+        }
+    }
+    for (i = ev_last; i > ev_first && events[i - 1].t > ((g->t16 + 0x8000) >> 16); --i) {
+        events[i] = events[i - 1];      // another generator is ahead of this one
+    }
+    events[i].t = (g->t16 + 0x8000) >> 16;
+    events[i].pin = g->pin;
+    events[i].level = level;
+    ++ev_last;
+}
+
+/**
+ * sim_gen_bits() - queue n bits, LSB first
+ */
+
+void sim_gen_bits(sim_gen_t *g, uint32_t bits, unsigned n)
+{
+    while (n--) {
+        gen_level(g, bits & 1);
+        bits >>= 1;
+        g->t16 += g->x16;
+    }
+}
+
+/**
+ * sim_gen_hold() - queue level for ticks, for breaks, glitches and gaps
+ */
+
+void sim_gen_hold(sim_gen_t *g, unsigned level, uint32_t ticks)
+{
+    gen_level(g, level);
+    g->t16 += (uint64_t)ticks << 16;
+}
+
+/**
+ * sim_gen_done() - when the generator runs out of bits
+ */
+
+uint64_t sim_gen_done(const sim_gen_t *g)
+{
+    return (g->t16 + 0x8000) >> 16;
+}
+
+//--------------------------------------------------------------------------------
+// R E G I S T E R S   A N D   I N T R I N S I C S
+//--------------------------------------------------------------------------------
+
+volatile uint16_t *sim_reg16(volatile uint16_t *reg)
+{
+    unsigned k;
+
+    for (k = SIM_ACCESS_TICKS; k; --k) {
+        step();
+    }
+    return reg;
+}
+
+volatile uint8_t *sim_reg8(volatile uint8_t *reg)
+{
+    unsigned k;
+
+    for (k = SIM_ACCESS_TICKS; k; --k) {
+        step();
+    }
+    return reg;
+}
+
+/**
+ * sim_taiv() - read TAxIV, clears the flag it reports
+ */
+
+uint16_t sim_taiv(unsigned timer)
+{
+    sim_timer_t *t = &sim.ta[timer];
+    unsigned i;
+
+    sim_reg16(&t->ctl);
+    for (i = 1; i < 3; ++i) {
+        if (pending(t->cctl[i])) {
+            t->cctl[i] &= ~CCIFG;
+            return i * 2;
+        }
+    }
+    if ((t->ctl & (TAIE | TAIFG)) == (TAIE | TAIFG)) {
+        t->ctl &= ~TAIFG;
+        return 0x0A;
+    }
+    return 0;
+}
+
+void sim_gie(unsigned on)
+{
+    step();
+    if (on) {
+        sim.sr |= GIE;
+        irq();
+    }
+    else {
+        sim.sr &= ~GIE;
+    }
+}
+
+void sim_delay(unsigned long ticks)
+{
+    while (ticks--) {
+        step();
+    }
+}
+
+/**
+ * sim_bis_sr() - set SR bits, with CPUOFF sleep until an ISR clears it on exit
+ */
+
+void sim_bis_sr(uint16_t bits)
+{
+    if (sim.in_isr) {
+        sim_fail("__bis_SR_register() in an ISR");
+    }
+    sim.sr |= bits;
+    irq();
+    while (sim.sr & CPUOFF) {
+        step();
+    }
+}
+
+void sim_bic_sr_on_exit(uint16_t bits)
+{
+    if (!sim.in_isr) {
+        sim_fail("__bic_SR_register_on_exit() outside an ISR");
+    }
+    sim.sr_isr &= ~bits;
+}
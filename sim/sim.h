@@ -0,0 +1,169 @@
+/**
+ * sim.h - host simulator of the msp430g2553 parts softserial uses
+ *
+ * Timer0_A3 and Timer1_A3 with their capture/compare units and output
+ * units, Port1/Port2 pins and interrupt flags, the WDT interval timer
+ * and the status register. sim/msp430.h maps the register names onto
+ * the sim struct, so softserial.c and friends compile unchanged.
+ *
+ * Time is counted in SMCLK ticks. The CPU is not simulated, instead
+ * every access to a Timer0_A, Port1 or status register costs
+ * SIM_ACCESS_TICKS, and interrupt entry and reti cost what they cost on
+ * the chip. Pending interrupts are taken between those accesses. Busy
+ * loops on TAR or on a flag therefore make progress, and the ISRs run
+ * at the compare and capture times they asked for. Timer1_A registers
+ * are reached through pointers by softserial_port.c and cost nothing.
+ *
+ * LPM3 stops SMCLK, TAR and TA1R stand still until an interrupt or
+ * the code clears SCG1 again. sim.now keeps counting, like ACLK does.
+ *
+ * The RX side is driven by wires from other pins or by a bit stream
+ * generator, see sim_gen_start().
+ *
+ * License: Do with this code what you want. However, don't blame
+ * me if you connect it to a heart pump and it stops.  This source
+ * is provided as is with no warranties. It probably has bugs!!
+ * You have been warned!
+ */
+
+#ifndef SIM_H_
+#define SIM_H_
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SIM_ACCESS_TICKS 3      // a mov to or from an absolute address
+#define SIM_IRQ_ENTRY    6      // push PC and SR, load the vector
+#define SIM_IRQ_RETI     5
+
+#define SIM_TRACE_MAX    32768  // pin changes sim_trace() remembers
+
+/**
+ * SIM_P1(), SIM_P2() - a pin, port number in the high byte and the BITx mask in the low byte
+ */
+#define SIM_P1(bit) (0x0100 | (bit))
+#define SIM_P2(bit) (0x0200 | (bit))
+
+/**
+ * sim_timer_t - one Timer_A3, the registers and the hardware state behind them
+ */
+typedef struct {
+    volatile uint16_t ctl;
+    volatile uint16_t r;
+    volatile uint16_t cctl[3];
+    volatile uint16_t ccr[3];
+
+    uint8_t cci[3];             // capture input, held while the pin is not selected
+    uint8_t scci[3];            // cci latched at the last EQU
+    uint8_t out[3];             // output unit
+    unsigned equ_count[3];      // EQU events since the test cleared it
+    uint64_t equ_first[3];      // time of the first of those
+} sim_timer_t;
+
+/**
+ * sim_port_t - one 8 bit I/O port
+ */
+typedef struct {
+    volatile uint8_t in;
+    volatile uint8_t out;
+    volatile uint8_t dir;
+    volatile uint8_t sel;
+    volatile uint8_t sel2;
+    volatile uint8_t ren;
+    volatile uint8_t ies;
+    volatile uint8_t ie;
+    volatile uint8_t ifg;
+
+    uint8_t ext;                // level the outside world drives, 1 where nothing does
+} sim_port_t;
+
+/**
+ * sim_t - the register file
+ */
+typedef struct {
+    sim_timer_t ta[2];
+    sim_port_t port[2];
+
+    volatile uint16_t wdtctl;
+    volatile uint8_t ie1;
+    volatile uint8_t ifg1;
+    volatile uint8_t ie2;
+    volatile uint8_t ifg2;
+    volatile uint8_t dcoctl;
+    volatile uint8_t bcsctl1;
+    volatile uint8_t bcsctl3;
+
+    volatile uint8_t uca0ctl0;  // USCI_A0, compiles but is not simulated
+    volatile uint8_t uca0ctl1;
+    volatile uint8_t uca0br0;
+    volatile uint8_t uca0br1;
+    volatile uint8_t uca0mctl;
+    volatile uint8_t uca0stat;
+    volatile uint8_t uca0txbuf;
+    volatile uint8_t uca0rxbuf;
+
+    uint16_t sr;                // GIE and the LPM bits
+    uint16_t sr_isr;            // SR the running ISR returns to
+    uint8_t in_isr;
+
+    uint64_t now;               // SMCLK ticks since sim_reset(), counts in LPM3 too
+    uint64_t deadline;          // sim_fail() when now gets past this
+    unsigned long f_cpu;
+} sim_t;
+
+extern sim_t sim;
+
+/**
+ * sim_trace_t - the changes of one pin, see sim_trace()
+ */
+typedef struct {
+    unsigned n;
+    uint64_t t[SIM_TRACE_MAX];
+    uint8_t level[SIM_TRACE_MAX];
+} sim_trace_t;
+
+extern sim_trace_t sim_traced;
+
+/**
+ * sim_gen_t - bit stream generator, drives a pin at its own baud rate
+ */
+typedef struct {
+    unsigned pin;
+    uint32_t x16;               // ticks per bit, 16.16 fixed point
+    uint64_t t16;               // when the next bit starts, in 1/65536 ticks
+    uint8_t level;
+} sim_gen_t;
+
+void sim_reset(unsigned long f_cpu);
+void sim_run(uint32_t ticks);
+void sim_deadline(uint32_t ticks);
+void sim_fail(const char *fmt, ...) __attribute__((noreturn, format(printf, 1, 2)));
+
+void sim_wire(unsigned from, unsigned to);
+void sim_drive(unsigned pin, unsigned level);
+unsigned sim_level(unsigned pin);
+void sim_trace(unsigned pin);
+
+void sim_gen_start(sim_gen_t *g, unsigned pin, uint32_t x16, uint32_t delay);
+void sim_gen_bits(sim_gen_t *g, uint32_t bits, unsigned n);
+void sim_gen_hold(sim_gen_t *g, unsigned level, uint32_t ticks);
+uint64_t sim_gen_done(const sim_gen_t *g);
+
+/**
+ * called by the register macros and intrinsics of sim/msp430.h
+ */
+volatile uint16_t *sim_reg16(volatile uint16_t *reg);
+volatile uint8_t *sim_reg8(volatile uint8_t *reg);
+uint16_t sim_taiv(unsigned timer);
+void sim_gie(unsigned on);
+void sim_delay(unsigned long ticks);
+void sim_bis_sr(uint16_t bits);
+void sim_bic_sr_on_exit(uint16_t bits);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+#endif /*SIM_H_*/
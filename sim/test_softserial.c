@@ -0,0 +1,1703 @@
+/**
+ * test_softserial.c - softserial.c on the host simulator, TX looped back to RX
+ *
+ * Built once per config by run_tests.py, or with make for the config.h
+ * in the parent directory. Each test runs in its own process on a
+ * freshly reset chip, so a failed test can't leave softserial.c half way
+ * through a frame for the next one. Tests that need a feature skip
+ * themselves when it is not in the build.
+ *
+ *   ./test_softserial          run all tests
+ *   ./test_softserial break    run the tests with break in the name
+ *
+ * License: Do with this code what you want. However, don't blame
+ * me if you connect it to a heart pump and it stops.  This source
+ * is provided as is with no warranties. It probably has bugs!!
+ * You have been warned!
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "msp430.h"
+#include "config.h"
+#include "softserial.h"
+#include "softserial_print.h"
+#include "dco.h"
+#if defined(SOFTSERIAL_PORTS)
+#include "softserial_port.h"
+#endif
+#include "sim.h"
+
+//------------------------------------------------------------
+// frame format, the same defaults as softserial.c
+//------------------------------------------------------------
+#ifdef SOFTSERIAL_DATA_BITS
+#define DATA_BITS SOFTSERIAL_DATA_BITS
+#else
+#define DATA_BITS 8
+#endif
+#if defined(SOFTSERIAL_PARITY) && SOFTSERIAL_PARITY != 'N'
+#define PARITY_BITS 1
+#else
+#define PARITY_BITS 0
+#endif
+#ifdef SOFTSERIAL_STOP_BITS
+#define STOP_BITS SOFTSERIAL_STOP_BITS
+#else
+#define STOP_BITS 1
+#endif
+
+#define FRAME_BITS (1 + DATA_BITS + PARITY_BITS + STOP_BITS)
+#define DATA_MASK  ((1 << DATA_BITS) - 1)
+#define X16        ((uint32_t)((F_CPU * 65536LL + BAUD_RATE/2) / BAUD_RATE))   // ticks per bit, 16.16
+#define BIT        (X16 >> 16)                                                 // whole ticks per bit
+
+#ifdef SOFTSERIAL_TIMER_TICKS
+#define TIMER_TICKS SOFTSERIAL_TIMER_TICKS
+#else
+#define TIMER_TICKS (F_CPU / 1000)                                                  // SoftSerial_timer_start() tick
+#endif
+
+#if defined(SOFTSERIAL_XONXOFF)
+#define FLOW_CHAR(c) ((c) == 0x11 || (c) == 0x13)  // XON and XOFF, not data
+#define FLOW_CHARS 2
+#else
+#define FLOW_CHAR(c) 0
+#define FLOW_CHARS 0
+#endif
+
+#define TX  SIM_P1(TX_PIN)
+#define RX  SIM_P1(RX_PIN)
+
+#define CHECK(cond) { \
+    if (!(cond)) { \
+        sim_fail("%s:%d: %s", __FILE__, __LINE__, #cond); \
+    } \
+}
+#define CHECK_EQ(a, b) { \
+    long long a_ = (a), b_ = (b); \
+    if (a_ != b_) { \
+        sim_fail("%s:%d: %s is %lld, expected %lld", __FILE__, __LINE__, #a, a_, b_); \
+    } \
+}
+
+//------------------------------------------------------------
+// helpers
+//------------------------------------------------------------
+
+static inline void run_to(uint64_t t)
+{
+    if (t > sim.now) {
+        sim_run(t - sim.now);
+    }
+}
+
+/**
+ * frame() - a character as it goes on the wire, start bit first
+ */
+
+static inline uint32_t frame(unsigned c, unsigned parity_ok, unsigned stop_ok)
+{
+    uint32_t bits = (uint32_t)(c & DATA_MASK) << 1;
+    unsigned n = DATA_BITS;
+
+#if PARITY_BITS
+    {
+        unsigned ones = __builtin_popcount(c & DATA_MASK);
+        unsigned p = (SOFTSERIAL_PARITY == 'E') ? (ones & 1) : !(ones & 1);
+
+        bits |= (uint32_t)(p ^ !parity_ok) << (1 + n);
+        ++n;
+    }
+#else
+    (void)parity_ok;
+#endif
+    if (stop_ok) {
+        bits |= (uint32_t)((1 << STOP_BITS) - 1) << (1 + n);
+    }
+    return bits;
+}
+
+/**
+ * send() - queue a character, let the sim run while the tx_buffer is full
+ *
+ * xmit() spins on RAM when the queue is full, which doesn't move time.
+ */
+
+static void send(unsigned c)
+{
+    while (!SoftSerial_tx_free()) {
+        sim_run(1);
+    }
+#if DATA_BITS > 8
+    SoftSerial_xmit9(c);
+#else
+    SoftSerial_xmit(c);
+#endif
+}
+
+/**
+ * recv() - the next character, or -1 if none came in ticks
+ */
+
+static inline int recv(uint32_t ticks)
+{
+    uint64_t end = sim.now + ticks;
+
+    while (SoftSerial_empty() && sim.now < end) {
+        sim_run(1);
+    }
+    return SoftSerial_read();
+}
+
+#if defined(SOFTSERIAL_STATS)
+static SoftSerial_stats_t stats(void)
+{
+    SoftSerial_stats_t s;
+
+    SoftSerial_get_stats(&s);
+    return s;
+}
+#endif
+
+/**
+ * start_edges() - count the start bits in the TX trace that are where back to back frames put them
+ */
+
+static inline unsigned start_edges(unsigned n, unsigned slack)
+{
+    uint64_t t0 = 0;
+    unsigned i, k = 0;
+
+    for (i = 0; i < sim_traced.n && k < n; ++i) {
+        uint64_t due;
+
+        if (sim_traced.level[i]) {
+            continue;
+        }
+        if (!k) {
+            t0 = sim_traced.t[i];
+        }
+        due = t0 + (((uint64_t)k * FRAME_BITS * X16 + 0x8000) >> 16);
+        if (sim_traced.t[i] + slack >= due && sim_traced.t[i] <= due + slack) {
+            ++k;
+        }
+    }
+    return k;
+}
+
+/**
+ * start_bit() - run until the trace holds a falling edge at i or later, returns its index
+ */
+
+static inline unsigned start_bit(unsigned i)
+{
+    while (i == sim_traced.n || sim_traced.level[i]) {
+        if (i == sim_traced.n) {
+            sim_run(1);
+        }
+        else {
+            ++i;
+        }
+    }
+    return i;
+}
+
+/**
+ * grid_end() - check the edges behind the start bit at i against its bit grid, returns the index of the next one
+ *
+ * Every edge of the frame has to be within a tick of a bit boundary.
+ * The next start bit is only checked to come no sooner than bits after
+ * the first. 0 when the trace has none.
+ */
+
+static inline unsigned grid_end(unsigned i, unsigned bits)
+{
+    uint64_t f = sim_traced.t[i];
+
+    while (++i < sim_traced.n) {
+        uint64_t d = sim_traced.t[i] - f;
+        uint64_t k = ((d << 16) + X16 / 2) / X16;
+        long long err = (long long)d - (long long)((k * X16 + 0x8000) >> 16);
+
+        if (!sim_traced.level[i] && k >= bits) {
+            CHECK(d >= ((uint64_t)bits * X16) >> 16);
+            return i;
+        }
+        if (llabs(err) > 1) {
+            sim_fail("edge %u is %lld ticks off bit %llu", i, err, (unsigned long long)k);
+        }
+    }
+    return 0;
+}
+
+/**
+ * rx_frames() - n frames of c into RX, wait until the last one is stored
+ */
+
+static inline void rx_frames(unsigned c, unsigned n)
+{
+    sim_gen_t g;
+
+    sim_gen_start(&g, RX, X16, BIT);
+    while (n--) {
+        sim_gen_bits(&g, frame(c, 1, 1), FRAME_BITS);
+    }
+    run_to(sim_gen_done(&g) + BIT);
+}
+
+/**
+ * rx_gen() - the characters of str into pin, back to back, returns when the last stop bit is sampled
+ */
+
+static inline void rx_gen(unsigned pin, const char *str)
+{
+    sim_gen_t g;
+
+    sim_gen_start(&g, pin, X16, BIT);
+    while (*str) {
+        sim_gen_bits(&g, frame(*str++, 1, 1), FRAME_BITS);
+    }
+    run_to(sim_gen_done(&g) + BIT);
+}
+
+/**
+ * traced_char() - the data bits of the frame whose start bit is at trace index i, runs to its end
+ */
+
+static inline unsigned traced_char(unsigned i)
+{
+    uint64_t f = sim_traced.t[i];
+    unsigned k, c = 0;
+
+    run_to(f + (((uint64_t)FRAME_BITS * X16) >> 16));
+    for (k = 0; k < DATA_BITS; ++k) {
+        uint64_t t = f + (((2 * k + 3) * (uint64_t)X16) >> 17);    // middle of the bit
+
+        while (i + 1 < sim_traced.n && sim_traced.t[i + 1] <= t) {
+            ++i;
+        }
+        c |= (unsigned)sim_traced.level[i] << k;
+    }
+    return c;
+}
+
+//------------------------------------------------------------
+// tests
+//------------------------------------------------------------
+
+/**
+ * loopback - every character value through TX and back in on RX, back to back
+ */
+
+static void test_loopback(void)
+{
+#if !defined(SOFTSERIAL_FRAMING) && !defined(SOFTSERIAL_RS485)   // framing holds the bytes to the frame end, RS-485 drops its echo
+    unsigned n = DATA_MASK + 1;
+    unsigned sent = 0, got = 0;
+
+    sim_wire(TX, RX);
+    sim_trace(TX);
+    sim_deadline((n + 20) * FRAME_BITS * (BIT + 1) * 2);
+
+    while (got < n) {
+        int c;
+
+        if (sent < n && SoftSerial_tx_free()) {
+            if (!FLOW_CHAR(sent)) {
+                send(sent);
+            }
+            ++sent;
+        }
+        c = SoftSerial_read();
+        if (c >= 0) {
+            while (FLOW_CHAR(got)) {
+                ++got;
+            }
+            CHECK_EQ(c, got);
+            ++got;
+        }
+        sim_run(1);
+    }
+    CHECK_EQ(start_edges(n, 2), n - FLOW_CHARS);    // no gaps between the frames
+#if defined(SOFTSERIAL_STATS)
+    CHECK_EQ(stats().framing, 0);
+    CHECK_EQ(stats().parity, 0);
+    CHECK_EQ(stats().noise, 0);
+    CHECK_EQ(stats().overrun, 0);
+#endif
+#endif
+}
+
+/**
+ * tx_timing - every TX edge is within half a tick of where the baud rate puts it
+ *
+ * The timer only has whole ticks, the 16.16 bit time has to round
+ * each edge to the nearest one, not let them all run late.
+ */
+
+static void test_tx_timing(void)
+{
+    unsigned i;
+    uint64_t t0;
+
+    sim_trace(TX);
+    sim.ta[0].equ_count[0] = 0;
+    sim_deadline(40 * FRAME_BITS * (BIT + 1));
+    for (i = 0; i < 32; ++i) {
+        send(i & 1 ? 0x55 : 0x0F);
+    }
+    SoftSerial_flush();
+
+    t0 = sim.ta[0].equ_first[0];        // the idle bit before the first start bit
+    CHECK(sim_traced.n > 32);
+    for (i = 0; i < sim_traced.n; ++i) {
+        uint64_t d = sim_traced.t[i] - t0;
+        uint64_t k = (d * BAUD_RATE + F_CPU / 2) / F_CPU;  // nearest bit boundary
+        long long err = (long long)(d * BAUD_RATE) - (long long)(k * F_CPU);
+
+        if (2 * llabs(err) > BAUD_RATE) {
+            sim_fail("edge %u is %.2f ticks off bit %llu", i, (double)err / BAUD_RATE, (unsigned long long)k);
+        }
+    }
+}
+
+/**
+ * tx_gap - a byte queued while the last bit before the stop bit is out
+ *
+ * The TX ISR keeps CCR0 until the stop bit is over, so the frame on the
+ * line keeps its bit grid and the new byte starts behind a full stop bit.
+ */
+
+static void test_tx_gap(void)
+{
+#if !defined(SOFTSERIAL_FRAMING)
+    unsigned last = FRAME_BITS - STOP_BITS - 1;                 // the bit before the stop bit
+    unsigned c = (frame(0x01, 1, 1) >> last) & 1 ? 0x03 : 0x01;  // ... is a 0
+    uint64_t f;
+    unsigned i;
+
+    sim_wire(TX, RX);
+    sim_deadline(8 * FRAME_BITS * (BIT + 1));
+
+    send(c);
+    SoftSerial_flush();                 // returns when the stop bit is out
+    CHECK(sim.now >= sim.ta[0].equ_first[0] + (((uint64_t)(FRAME_BITS + 1) * X16) >> 16));
+#if !defined(SOFTSERIAL_RS485)
+    CHECK_EQ(recv(FRAME_BITS * BIT), c);
+#endif
+
+    sim_trace(TX);
+    send(c);
+    i = start_bit(0);
+    f = sim_traced.t[i];
+    run_to(f + (((uint64_t)last * X16) >> 16) + 7 * BIT / 10);
+    send(0x41);
+#if defined(SOFTSERIAL_RS485)
+    SoftSerial_flush();                 // the RX ISR drops our echo
+#else
+    CHECK_EQ(recv(4 * FRAME_BITS * BIT), c);
+    CHECK_EQ(recv(4 * FRAME_BITS * BIT), 0x41 & DATA_MASK);
+#endif
+    CHECK(grid_end(i, FRAME_BITS));
+#if defined(SOFTSERIAL_STATS)
+    CHECK_EQ(stats().framing, 0);
+#endif
+#endif
+}
+
+/**
+ * receive - a perfect sender at our baud rate, with idle time between characters
+ */
+
+static void test_receive(void)
+{
+#if !defined(SOFTSERIAL_FRAMING)
+    static const unsigned chars[] = { 0x55, 0xAA, 0x00, 0xFF, 0x01, 0x80, 0x0F, 0xF0, 0x1FF, 0x100 };
+    sim_gen_t g;
+    unsigned i;
+
+    sim_gen_start(&g, RX, X16, BIT);
+    for (i = 0; i < sizeof(chars)/sizeof(chars[0]); ++i) {
+        sim_gen_bits(&g, frame(chars[i], 1, 1), FRAME_BITS);
+        sim_gen_hold(&g, 1, i * BIT / 3);
+    }
+    sim_deadline(sim_gen_done(&g) - sim.now + 4 * FRAME_BITS * BIT);
+    for (i = 0; i < sizeof(chars)/sizeof(chars[0]); ++i) {
+        CHECK_EQ(recv(2 * FRAME_BITS * BIT), chars[i] & DATA_MASK);
+    }
+#endif
+}
+
+/**
+ * skew - a sender whose clock is off by 90% of what SoftSerial_rx_skew() says we take
+ */
+
+static void test_skew(void)
+{
+#if !defined(SOFTSERIAL_FRAMING)
+    static const unsigned chars[] = { 0x00, 0xFF, 0x55, 0xAA, 0x01, 0x80, 0x7E, 0x81 };
+    int dir;
+
+    for (dir = -1; dir <= 1; dir += 2) {
+        sim_gen_t g;
+        unsigned i, skew;
+        uint32_t x16;
+
+        sim_gen_start(&g, RX, X16, BIT);
+        sim_gen_bits(&g, frame(0x5A, 1, 1), FRAME_BITS);    // warm up, the vote sampler counts its latency
+        run_to(sim_gen_done(&g) + BIT);
+        CHECK_EQ(SoftSerial_read(), 0x5A & DATA_MASK);
+
+        skew = SoftSerial_rx_skew() * 9 / 10;
+        CHECK(skew > 0);
+        x16 = (uint32_t)((uint64_t)X16 * (1000 + dir * (int)skew) / 1000);
+
+        sim_gen_start(&g, RX, x16, BIT);
+        for (i = 0; i < sizeof(chars)/sizeof(chars[0]); ++i) {
+            sim_gen_bits(&g, frame(chars[i], 1, 1), FRAME_BITS);
+            sim_gen_hold(&g, 1, x16 >> 16);                 // one idle bit, the skew is per frame
+        }
+        sim_deadline(sim_gen_done(&g) - sim.now + 4 * FRAME_BITS * BIT);
+        for (i = 0; i < sizeof(chars)/sizeof(chars[0]); ++i) {
+            int c = recv(2 * FRAME_BITS * BIT);
+
+            if (c != (int)(chars[i] & DATA_MASK)) {
+                sim_fail("skew %c%u/1000, char %u is %d, expected %u", dir < 0 ? '-' : '+', skew, i, c, chars[i] & DATA_MASK);
+            }
+        }
+        run_to(sim.now + 2 * FRAME_BITS * BIT);
+        sim.deadline = UINT64_MAX;
+    }
+#endif
+}
+
+/**
+ * framing - a 0 stop bit, the next good character after a frame of idle line still comes in
+ *
+ * Without the stop bit sample the rising edge in or after the bad stop
+ * bits can look like the end of a start bit, so the idle line is needed
+ * to get back in step, like on any UART.
+ */
+
+static void test_framing(void)
+{
+#if !defined(SOFTSERIAL_FRAMING)
+    sim_gen_t g;
+    int c, last = -1;
+
+    sim_gen_start(&g, RX, X16, BIT);
+    sim_gen_bits(&g, frame(0x55, 1, 0), FRAME_BITS);
+    sim_gen_hold(&g, 1, (FRAME_BITS + 1) * BIT);
+    sim_gen_bits(&g, frame(0x33, 1, 1), FRAME_BITS);
+    sim_deadline(sim_gen_done(&g) - sim.now + 4 * FRAME_BITS * BIT);
+    run_to(sim_gen_done(&g) + BIT);
+
+    while ((c = SoftSerial_read()) >= 0) {
+        last = c;
+    }
+    CHECK_EQ(last, 0x33 & DATA_MASK);
+#if defined(SOFTSERIAL_STATS)
+    CHECK_EQ(stats().framing, 1);
+#endif
+#endif
+}
+
+/**
+ * parity - a character with the wrong parity is dropped
+ */
+
+static void test_parity(void)
+{
+#if PARITY_BITS
+    sim_gen_t g;
+
+    sim_gen_start(&g, RX, X16, BIT);
+    sim_gen_bits(&g, frame(0x21, 0, 1), FRAME_BITS);
+    sim_gen_bits(&g, frame(0x42, 1, 1), FRAME_BITS);
+    sim_gen_bits(&g, frame(0x07, 0, 1), FRAME_BITS);
+    sim_gen_bits(&g, frame(0x18, 1, 1), FRAME_BITS);
+    sim_deadline(sim_gen_done(&g) - sim.now + 4 * FRAME_BITS * BIT);
+    run_to(sim_gen_done(&g) + BIT);
+
+    CHECK_EQ(SoftSerial_read(), 0x42 & DATA_MASK);
+    CHECK_EQ(SoftSerial_read(), 0x18 & DATA_MASK);
+    CHECK_EQ(SoftSerial_read(), -1);
+#if defined(SOFTSERIAL_STATS)
+    CHECK_EQ(stats().parity, 2);
+#endif
+#endif
+}
+
+#if defined(SOFTSERIAL_BREAK)
+static unsigned line_breaks, line_idles;
+static unsigned line_wake;              // the idle event ends SoftSerial_sleep()
+
+static unsigned on_line(unsigned event)
+{
+    if (event == SOFTSERIAL_LINE_BREAK) {
+        ++line_breaks;
+    }
+    else if (event == SOFTSERIAL_LINE_IDLE) {
+        ++line_idles;
+        return line_wake;
+    }
+    return 0;
+}
+#endif
+
+/**
+ * break_rx - a line held low is one break event and no data, a real 0 is data
+ */
+
+static void test_break_rx(void)
+{
+#if defined(SOFTSERIAL_BREAK)
+    sim_gen_t g;
+
+    line_breaks = 0;
+    SoftSerial_line_events(on_line, 0);
+
+    sim_gen_start(&g, RX, X16, BIT);
+    sim_gen_hold(&g, 0, 2 * FRAME_BITS * BIT);
+    sim_gen_hold(&g, 1, 2 * BIT);
+    sim_gen_bits(&g, frame(0x00, 1, 1), FRAME_BITS);
+    sim_deadline(sim_gen_done(&g) - sim.now + 4 * FRAME_BITS * BIT);
+    run_to(sim_gen_done(&g) + BIT);
+
+    CHECK_EQ(line_breaks, 1);
+    CHECK_EQ(SoftSerial_read(), 0);
+    CHECK_EQ(SoftSerial_read(), -1);
+#if defined(SOFTSERIAL_STATS)
+    CHECK_EQ(stats().brk, 1);
+#endif
+#endif
+}
+
+/**
+ * break_tx - SoftSerial_send_break() right behind a byte, looped back
+ *
+ * The stop bit goes out first, the break is exactly bits bit times long
+ * and the receiver reports it.
+ */
+
+static void test_break_tx(void)
+{
+#if defined(SOFTSERIAL_BREAK)
+    unsigned i, lows = 0;
+    uint64_t low = 0, len = 0;
+
+    line_breaks = 0;
+    SoftSerial_line_events(on_line, 0);
+    sim_wire(TX, RX);
+    sim_trace(TX);
+    sim_deadline(40 * FRAME_BITS * BIT);
+
+    send(0x41);
+    SoftSerial_send_break(13);
+    send(0x42);
+    SoftSerial_flush();
+    run_to(sim.now + 2 * FRAME_BITS * BIT);
+
+    for (i = 0; i < sim_traced.n; ++i) {
+        if (!sim_traced.level[i]) {
+            low = sim_traced.t[i];
+        }
+        else if (sim_traced.t[i] - low > len) {
+            len = sim_traced.t[i] - low;
+        }
+        lows += !sim_traced.level[i];
+    }
+    CHECK_EQ(len, 13 * BIT);
+    CHECK_EQ(line_breaks, 1);
+    CHECK_EQ(SoftSerial_read(), 0x41 & DATA_MASK);
+    CHECK_EQ(SoftSerial_read(), 0x42 & DATA_MASK);
+    CHECK_EQ(SoftSerial_read(), -1);
+    CHECK(lows > 2);
+#endif
+}
+
+/**
+ * break_stale - a TACCR0 left from long ago doesn't hold up the break
+ */
+
+static void test_break_stale(void)
+{
+#if defined(SOFTSERIAL_BREAK)
+    uint64_t call;
+
+    sim_trace(TX);
+    sim_deadline(0x10000 + 40 * FRAME_BITS * BIT);
+
+    send(0x41);
+    SoftSerial_flush();
+    run_to(sim.now + 0xA000);           // TACCR0 looks 0x6000 ticks ahead now
+    call = sim.now;
+    SoftSerial_send_break(2);
+    CHECK(sim_traced.n >= 2);
+    CHECK(sim_traced.t[sim_traced.n - 2] < call + 2 * BIT);
+    CHECK_EQ(sim_traced.t[sim_traced.n - 1] - sim_traced.t[sim_traced.n - 2], 2 * BIT);
+    SoftSerial_send_break(0);
+    CHECK(sim.now < call + 4 * BIT);
+#endif
+}
+
+/**
+ * line_idle - one idle event idle_bits after the stop bit of the last character
+ */
+
+static void test_line_idle(void)
+{
+#if defined(SOFTSERIAL_BREAK) && defined(__MSP430_HAS_TA3__) && !defined(SOFTSERIAL_FRAMING)
+    sim_gen_t g;
+    uint64_t stop;
+
+    line_idles = 0;
+    SoftSerial_line_events(on_line, 4);
+
+    sim_gen_start(&g, RX, X16, BIT);
+    sim_gen_bits(&g, frame(0x31, 1, 1), FRAME_BITS);
+    sim_gen_bits(&g, frame(0x32, 1, 1), FRAME_BITS);
+    stop = sim_gen_done(&g);            // end of the last stop bit
+    sim_deadline(sim_gen_done(&g) - sim.now + 8 * BIT);
+
+    run_to(stop + 4 * BIT - BIT / 2);
+    CHECK_EQ(line_idles, 0);
+    run_to(stop + 4 * BIT + BIT / 2);
+    CHECK_EQ(line_idles, 1);
+    run_to(sim.now + 3 * BIT);
+    CHECK_EQ(line_idles, 1);
+    CHECK_EQ(SoftSerial_available(), 2);
+#endif
+}
+
+/**
+ * dco_end - the DCO tracker nudges a drifting DCO, but not after SoftSerial_end()
+ *
+ * The sim's SMCLK doesn't drift, so the watch crystal is made 1% slow
+ * instead. The WDT interval gets longer and SMCLK looks 1% fast.
+ */
+
+static void test_dco_end(void)
+{
+#if defined(RECALIBRATE_DCO)
+    uint32_t window = 262144;           // about what dco.c counts per window
+    uint8_t dcoctl = sim.dcoctl;
+
+    sim.f_cpu = F_CPU + F_CPU / 100;
+    DCO_track_start();
+    run_to(sim.now + 3 * window);
+    CHECK(sim.dcoctl != dcoctl);        // slower, and again each window
+
+    SoftSerial_end();
+    dcoctl = sim.dcoctl;
+    run_to(sim.now + 3 * window);
+    CHECK_EQ(sim.dcoctl, dcoctl);
+    DCO_track_stop();
+#endif
+}
+
+/**
+ * port_loopback - a Timer1_A3 port sends to itself and to a receive only port
+ *
+ * SoftSerial_port_flush() and SoftSerial_port_end() on the receive only
+ * port have no TX side to wait for.
+ */
+
+static void test_port_loopback(void)
+{
+#if defined(SOFTSERIAL_PORTS)
+    static SoftSerial_t duplex = SOFTSERIAL_PORT(0, BIT0, 1, BIT2, CCIS_1);     // TX P2.0, RX P2.2
+    static SoftSerial_t listen = SOFTSERIAL_PORT(SOFTSERIAL_NONE, 0, 2, BIT4, CCIS_0); // RX P2.4
+    unsigned sent = 0, got = 0, heard = 0;
+
+    SoftSerial_port_init(&duplex, BAUD_RATE);
+    SoftSerial_port_init(&listen, BAUD_RATE);
+    sim_wire(SIM_P2(BIT0), SIM_P2(BIT2));
+    sim_wire(SIM_P2(BIT0), SIM_P2(BIT4));
+    sim_deadline(300 * 10 * (BIT + 1) * 2);
+
+    while (got < 256 || heard < 256) {
+        int c;
+
+        if (sent < 256 && SoftSerial_port_tx_free(&duplex)) {
+            SoftSerial_port_xmit(&duplex, sent++);
+        }
+        if ((c = SoftSerial_port_read(&duplex)) >= 0) {
+            CHECK_EQ(c, got);
+            ++got;
+        }
+        if ((c = SoftSerial_port_read(&listen)) >= 0) {
+            CHECK_EQ(c, heard);
+            ++heard;
+        }
+        sim_run(1);
+    }
+
+    SoftSerial_port_flush(&listen);
+    SoftSerial_port_end(&listen);
+    SoftSerial_port_end(&duplex);
+    CHECK_EQ(sim.ta[1].ctl & MC_3, 0);  // the last port stops Timer1_A3
+#endif
+}
+
+/**
+ * port_gap - a port byte queued in the last data bit, and port_flush() waits for the stop bit
+ */
+
+static void test_port_gap(void)
+{
+#if defined(SOFTSERIAL_PORTS)
+    static SoftSerial_t duplex = SOFTSERIAL_PORT(0, BIT0, 1, BIT2, CCIS_1);     // TX P2.0, RX P2.2
+    uint64_t f;
+    unsigned i;
+
+    SoftSerial_port_init(&duplex, BAUD_RATE);
+    sim_wire(SIM_P2(BIT0), SIM_P2(BIT2));
+    sim_trace(SIM_P2(BIT0));
+    sim_deadline(8 * 10 * (BIT + 1));
+
+    SoftSerial_port_xmit(&duplex, 0x01);
+    i = start_bit(0);
+    f = sim_traced.t[i];
+    SoftSerial_port_flush(&duplex);
+    CHECK(sim.now >= f + ((10ULL * X16) >> 16));
+
+    SoftSerial_port_xmit(&duplex, 0x01);
+    i = start_bit(i + 1);
+    f = sim_traced.t[i];
+    run_to(f + ((8ULL * X16) >> 16) + 7 * BIT / 10);    // 0.7 into d7
+    SoftSerial_port_xmit(&duplex, 0x41);
+    SoftSerial_port_flush(&duplex);
+    SoftSerial_port_end(&duplex);
+    CHECK(grid_end(i, 10));
+
+    CHECK_EQ(SoftSerial_port_read(&duplex), 0x01);
+    CHECK_EQ(SoftSerial_port_read(&duplex), 0x01);
+    CHECK_EQ(SoftSerial_port_read(&duplex), 0x41);
+#endif
+}
+
+/**
+ * stale_edge - a start bit a multiple of 65536 ticks after the last edge is not a glitch
+ */
+
+static void test_stale_edge(void)
+{
+#if defined(SOFTSERIAL_RX_EDGES) && defined(SOFTSERIAL_RX_VOTE) && !defined(SOFTSERIAL_VOTE_TICKS)
+    sim_gen_t g;
+    uint64_t rise;
+
+    if ((BIT >> 4) < 4) {
+        return;                         // VOTE_TICKS too short to land in
+    }
+    sim_trace(RX);
+    sim_gen_start(&g, RX, X16, BIT);
+    sim_gen_bits(&g, frame(DATA_MASK, 1, 1), FRAME_BITS);
+    sim_deadline(sim_gen_done(&g) - sim.now + 0x10000 + 4 * FRAME_BITS * BIT);
+    CHECK_EQ(recv(2 * FRAME_BITS * BIT), DATA_MASK);
+    rise = sim_traced.t[sim_traced.n - 1];  // rx_edge
+
+    sim_gen_start(&g, RX, X16, rise + 0x10000 + (BIT >> 5) - sim.now);
+    sim_gen_bits(&g, frame(0x5A, 1, 1), FRAME_BITS);
+    CHECK_EQ(recv(sim_gen_done(&g) - sim.now + 2 * BIT), 0x5A);
+#endif
+}
+
+/**
+ * port_bridge - a bridge to a port without TX is refused, the bytes stay in the rx_buffer
+ */
+
+static void test_port_bridge(void)
+{
+#if defined(SOFTSERIAL_PORTS) && defined(SOFTSERIAL_BRIDGE)
+    static SoftSerial_t duplex = SOFTSERIAL_PORT(0, BIT0, 1, BIT2, CCIS_1);     // TX P2.0, RX P2.2
+    static SoftSerial_t listen = SOFTSERIAL_PORT(SOFTSERIAL_NONE, 0, 2, BIT4, CCIS_0); // RX P2.4
+    int c;
+
+    SoftSerial_port_init(&duplex, BAUD_RATE);
+    SoftSerial_port_init(&listen, BAUD_RATE);
+    sim_wire(SIM_P2(BIT0), SIM_P2(BIT2));
+    sim_wire(TX, RX);
+    sim_deadline(8 * 10 * (BIT + 1) * 2);
+
+    SoftSerial_port_bridge(&listen, SOFTSERIAL_BRIDGE_ECHO, 0, 0, 0);
+    CHECK_EQ(listen.bridge_mode, SOFTSERIAL_BRIDGE_OFF);
+    SoftSerial_port_bridge(&duplex, SOFTSERIAL_BRIDGE_PORT, &listen, 0, 0);
+    CHECK_EQ(duplex.bridge_mode, SOFTSERIAL_BRIDGE_OFF);
+    SoftSerial_bridge(SOFTSERIAL_BRIDGE_PORT, &listen, 0, 0);
+
+    SoftSerial_port_xmit(&duplex, 0x41);
+    send(0x42);
+    while ((c = SoftSerial_port_read(&duplex)) < 0) {
+        sim_run(BIT);
+    }
+    CHECK_EQ(c, 0x41);
+    CHECK_EQ(recv(2 * 10 * BIT), 0x42);
+#endif
+}
+
+#if defined(SOFTSERIAL_BRIDGE)
+
+/**
+ * bridge_tables() - xlat swaps the case of letters, pass lets only letters through
+ */
+
+static void bridge_tables(uint8_t xlat[256], uint8_t pass[32])
+{
+    unsigned c;
+
+    memset(pass, 0, 32);
+    for (c = 0; c < 256; ++c) {
+        xlat[c] = c;
+        if ((c | 0x20) >= 'a' && (c | 0x20) <= 'z') {
+            xlat[c] = c ^ 0x20;
+            pass[c >> 3] |= 1 << (c & 7);
+        }
+    }
+}
+#endif
+
+/**
+ * bridge_echo - SOFTSERIAL_BRIDGE_ECHO sends what passes, translated, back out of TX
+ */
+
+static void test_bridge_echo(void)
+{
+#if defined(SOFTSERIAL_BRIDGE) && DATA_BITS == 8 && !PARITY_BITS
+    static uint8_t xlat[256], pass[32];
+    unsigned i;
+
+    bridge_tables(xlat, pass);
+    sim_trace(TX);
+    sim_deadline(16 * FRAME_BITS * (BIT + 1));
+    SoftSerial_bridge(SOFTSERIAL_BRIDGE_ECHO, 0, xlat, pass);
+
+    rx_gen(RX, "a1Bc");
+    SoftSerial_flush();
+    CHECK_EQ(SoftSerial_available(), 0);
+    i = start_bit(0);
+    CHECK_EQ(traced_char(i), 'A');
+    CHECK((i = grid_end(i, FRAME_BITS)));
+    CHECK_EQ(traced_char(i), 'b');
+    CHECK((i = grid_end(i, FRAME_BITS)));
+    CHECK_EQ(traced_char(i), 'C');
+    CHECK_EQ(grid_end(i, FRAME_BITS), 0);
+
+    SoftSerial_bridge(SOFTSERIAL_BRIDGE_OFF, 0, 0, 0);
+    rx_gen(RX, "1");
+    CHECK_EQ(SoftSerial_read(), '1');
+#endif
+}
+
+/**
+ * bridge_port - SOFTSERIAL_BRIDGE_PORT from softserial.c to a port, SOFTSERIAL_BRIDGE_MAIN back
+ */
+
+static void test_bridge_port(void)
+{
+#if defined(SOFTSERIAL_BRIDGE) && defined(SOFTSERIAL_PORTS)
+    static SoftSerial_t duplex = SOFTSERIAL_PORT(0, BIT0, 1, BIT2, CCIS_1);     // TX P2.0, RX P2.2
+    static SoftSerial_t listen = SOFTSERIAL_PORT(SOFTSERIAL_NONE, 0, 2, BIT4, CCIS_0); // RX P2.4
+    static uint8_t xlat[256], pass[32];
+    unsigned i;
+
+    bridge_tables(xlat, pass);
+    SoftSerial_port_init(&duplex, BAUD_RATE);
+    SoftSerial_port_init(&listen, BAUD_RATE);
+    sim_wire(SIM_P2(BIT0), SIM_P2(BIT4));
+    sim_trace(TX);
+    sim_deadline(24 * 10 * (BIT + 1));
+
+    SoftSerial_bridge(SOFTSERIAL_BRIDGE_PORT, &duplex, xlat, pass);
+    SoftSerial_port_bridge(&duplex, SOFTSERIAL_BRIDGE_MAIN, 0, xlat, 0);
+
+    rx_gen(RX, "x-Y");                  // softserial.c RX, out of the duplex port
+    SoftSerial_port_flush(&duplex);
+    CHECK_EQ(SoftSerial_available(), 0);
+    CHECK_EQ(SoftSerial_port_read(&listen), 'X');
+    CHECK_EQ(SoftSerial_port_read(&listen), 'y');
+    CHECK_EQ(SoftSerial_port_read(&listen), -1);
+
+    rx_gen(SIM_P2(BIT2), "q-");         // duplex port RX, out of softserial.c TX
+    SoftSerial_flush();
+    CHECK_EQ(SoftSerial_port_read(&duplex), -1);
+    i = start_bit(0);
+    CHECK_EQ(traced_char(i), 'Q');
+    CHECK((i = grid_end(i, FRAME_BITS)));
+    CHECK_EQ(traced_char(i), '-');      // no pass table this way
+    CHECK_EQ(grid_end(i, FRAME_BITS), 0);
+#if defined(SOFTSERIAL_STATS)
+    CHECK_EQ(stats().bridge, 0);
+#endif
+#endif
+}
+
+/**
+ * lpm3_idle - SoftSerial_sleep() must not stop SMCLK while CCR2 times the 'G' gap or the idle event
+ */
+
+static void test_lpm3_idle(void)
+{
+#if defined(SOFTSERIAL_LPM3) && (defined(SOFTSERIAL_FRAMING) \
+        || (defined(SOFTSERIAL_BREAK) && defined(__MSP430_HAS_TA3__)))
+    sim_gen_t g;
+    uint64_t stop;
+
+#if defined(SOFTSERIAL_FRAMING)
+    SoftSerial_wake_on(1, -1, 0);       // a published frame
+#else
+    line_idles = 0;
+    line_wake = 1;
+    SoftSerial_line_events(on_line, 4);
+    SoftSerial_wake_on(0, -1, 0);       // only the idle event
+#endif
+
+    sim_gen_start(&g, RX, X16, 2 * BIT);
+    sim_gen_bits(&g, frame(0x31, 1, 1), FRAME_BITS);
+    sim_gen_bits(&g, frame(0x32, 1, 1), FRAME_BITS);
+    stop = sim_gen_done(&g);
+    sim_deadline(stop - sim.now + 8 * FRAME_BITS * BIT);
+
+    run_to(stop + BIT);                 // the last stop bit is in, CCR2 is armed
+    SoftSerial_sleep();
+#if defined(SOFTSERIAL_FRAMING)
+    CHECK(sim.now < stop + 4 * FRAME_BITS * BIT);
+    CHECK_EQ(SoftSerial_frame_available(), 2);
+#else
+    CHECK(sim.now < stop + 5 * BIT);
+    CHECK_EQ(line_idles, 1);
+    CHECK_EQ(SoftSerial_available(), 2);
+#endif
+#endif
+}
+
+/**
+ * spans - bytes written in place with tx_reserve() come back through rx_peek()
+ */
+
+static void test_spans(void)
+{
+#if defined(SOFTSERIAL_SPANS) && !defined(SOFTSERIAL_FRAMING) && !defined(SOFTSERIAL_RS485)
+    SoftSerial_span_t span[2];
+    unsigned i, n = 10;
+
+    CHECK_EQ(sizeof(*span[0].data), 1);
+    sim_wire(TX, RX);
+    sim_deadline((n + 4) * FRAME_BITS * (BIT + 1) * 2);
+
+    CHECK(SoftSerial_tx_reserve(span) >= n);
+    for (i = 0; i < n; ++i) {
+        if (i < span[0].len) {
+            span[0].data[i] = 0x30 + i;
+        }
+        else {
+            span[1].data[i - span[0].len] = 0x30 + i;
+        }
+    }
+    SoftSerial_tx_commit(n);
+
+    while (SoftSerial_rx_peek(span) < n) {
+        sim_run(BIT);
+    }
+    for (i = 0; i < n; ++i) {
+        CHECK_EQ(i < span[0].len ? span[0].data[i] : span[1].data[i - span[0].len], (0x30 + i) & DATA_MASK);
+    }
+    SoftSerial_rx_commit(n);
+    CHECK_EQ(SoftSerial_available(), 0);
+#endif
+}
+
+/**
+ * set_baud - what was queued goes out at the old rate, then the new rate takes over
+ */
+
+static void test_set_baud(void)
+{
+#if defined(SOFTSERIAL_RUNTIME_BAUD)
+    unsigned i, last;
+
+    sim_wire(TX, RX);
+    sim_trace(TX);
+    sim_deadline(40 * FRAME_BITS * 2 * (BIT + 1));
+    for (i = 0; i < 3; ++i) {
+        send(0x61 + i);
+    }
+    CHECK_EQ(SoftSerial_set_baud(BAUD_RATE / 2), BAUD_RATE / 2);
+    CHECK_EQ(SoftSerial_tx_free(), TX_BUFFER_SIZE - 1);
+    last = start_bit(0);
+    for (i = 1; i < 3; ++i) {
+        CHECK((last = grid_end(last, FRAME_BITS)));
+    }
+    CHECK_EQ(grid_end(last, FRAME_BITS), 0);
+    CHECK(sim.now >= sim_traced.t[last] + (((uint64_t)FRAME_BITS * X16) >> 16));   // the stop bit at the old rate
+    for (i = 0; i < 3; ++i) {
+        CHECK_EQ(recv(2 * FRAME_BITS * BIT), 0x61 + i);
+    }
+
+    send(0x64);
+    CHECK_EQ(recv(4 * FRAME_BITS * BIT), 0x64);
+    CHECK_EQ(SoftSerial_baud(), BAUD_RATE / 2);
+#endif
+}
+
+//------------------------------------------------------------
+// runner
+//------------------------------------------------------------
+
+typedef struct {
+    const char *name;
+    void (*fn)(void);
+} test_t;
+
+#if defined(SOFTSERIAL_FRAMING) && SOFTSERIAL_FRAMING == 'C'
+
+/**
+ * crc16() - CRC-16/CCITT like softserial.c puts behind each frame
+ */
+
+static uint16_t crc16(const uint8_t *buf, unsigned n)
+{
+    uint16_t crc = 0xFFFF;
+    unsigned i, k;
+
+    for (i = 0; i < n; ++i) {
+        crc ^= (uint16_t)buf[i] << 8;
+        for (k = 0; k < 8; ++k) {
+            crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+        }
+    }
+    return crc;
+}
+#endif
+
+#if defined(SOFTSERIAL_FRAMING) && SOFTSERIAL_FRAMING != 'G'
+
+/**
+ * frame_trip() - send n bytes of buf as a frame through the loopback, it has to come back whole
+ */
+
+static void frame_trip(const uint8_t *buf, unsigned n)
+{
+    static uint8_t got[RX_BUFFER_SIZE];
+    uint64_t end;
+
+    SoftSerial_frame_write(buf, n);
+    end = sim.now + 2 * (n + 8) * FRAME_BITS * BIT;
+    while (!SoftSerial_frame_available() && sim.now < end) {
+        sim_run(BIT);
+    }
+    CHECK_EQ(SoftSerial_frame_available(), n);
+    CHECK_EQ(SoftSerial_frame_read(got, sizeof(got)), n);
+    if (memcmp(got, buf, n)) {
+        sim_fail("a frame of %u bytes came back changed", n);
+    }
+}
+
+/**
+ * frame_bad() - send raw bytes that the frame decoder has to drop
+ */
+
+static void frame_bad(const uint8_t *raw, unsigned n)
+{
+    unsigned i;
+
+    for (i = 0; i < n; ++i) {
+        send(raw[i]);
+    }
+    SoftSerial_flush();
+    run_to(sim.now + 2 * FRAME_BITS * BIT);
+    CHECK_EQ(SoftSerial_frame_available(), 0);
+}
+#endif
+
+/**
+ * frames - COBS or SLIP frames go through the RX ISR decoder and come back whole, bad ones are dropped
+ */
+
+static void test_frames(void)
+{
+#if defined(SOFTSERIAL_FRAMING) && SOFTSERIAL_FRAMING != 'G'
+    static uint8_t buf[256];
+#if SOFTSERIAL_FRAMING == 'S'
+    static const uint8_t escapes[] = { 0xC0, 0xDB, 0xDC, 0xDD, 0xDB, 0xC0 };
+    static const uint8_t bad_crc[] = { 0xC0, 'a', 'b', 0x12, 0x34, 0xC0 };
+    static const uint8_t bad_esc[] = { 0xC0, 'a', 0xDB, 'x', 'b', 0xC0 };   // 0xDB 'x' is no escape
+#else
+    static const uint8_t ones[] = { 0x01, 0x00, 0x01 };
+    static const uint8_t zeros[] = { 0x00, 0x00 };
+    static const uint8_t bad_crc[] = { 0x05, 'a', 'b', 0x12, 0x34, 0x00 };
+    static const uint8_t bad_len[] = { 0x09, 'a', 'b', 0x00 };          // block cut short by the delimiter
+    uint16_t crc;
+    unsigned i;
+#endif
+
+    sim_wire(TX, RX);
+    sim_deadline(1200 * FRAME_BITS * (BIT + 1));
+
+#if SOFTSERIAL_FRAMING == 'S'
+    frame_trip(escapes, sizeof(escapes));
+    frame_trip(escapes, 1);
+    frame_bad(bad_crc, sizeof(bad_crc));
+    frame_bad(bad_esc, sizeof(bad_esc));
+#if defined(SOFTSERIAL_STATS)
+    CHECK_EQ(stats().badframe, 2);
+#endif
+    buf[0] = 'a';
+    frame_trip(buf, 1);                 // the decoder is back in step
+#else
+    frame_trip(ones, 1);                // 0x01 as data
+    frame_trip(ones, sizeof(ones));     // 0x01 as data and as the code for a lone 0
+    frame_trip(zeros, 1);
+    frame_trip(zeros, sizeof(zeros));
+
+    // 252 bytes and the CRC fill one 254 byte block exactly, a 0xFF code
+    // with no 0 behind it. Pick the data so the CRC has no 0 byte.
+    for (i = 0; i < 252; ++i) {
+        buf[i] = 1 + i % 255;
+    }
+    do {
+        crc = crc16(buf, 252);
+    } while ((!(crc >> 8) || !(crc & 0xFF)) && ++buf[0]);
+    frame_trip(buf, 252);
+    buf[252] = 0x5A;
+    frame_trip(buf, 253);               // one past, the CRC ends in a block of its own
+    frame_trip(buf, 254 - 2 - 1);       // one short
+
+    frame_bad(bad_crc, sizeof(bad_crc));
+    frame_bad(bad_len, sizeof(bad_len));
+#if defined(SOFTSERIAL_STATS)
+    CHECK_EQ(stats().badframe, 2);
+#endif
+    frame_trip(ones, 1);
+#endif
+#endif
+}
+
+#if defined(SOFTSERIAL_FLOW_HIGH)
+#define FLOW_HIGH SOFTSERIAL_FLOW_HIGH
+#else
+#define FLOW_HIGH (RX_BUFFER_SIZE / 2)
+#endif
+#if defined(SOFTSERIAL_FLOW_LOW)
+#define FLOW_LOW SOFTSERIAL_FLOW_LOW
+#else
+#define FLOW_LOW (RX_BUFFER_SIZE / 4)
+#endif
+
+/**
+ * flow_rts - RTS goes high when the rx_buffer reaches FLOW_HIGH, low again when read() drains it to FLOW_LOW
+ */
+
+static void test_flow_rts(void)
+{
+#if defined(SOFTSERIAL_RTSCTS)
+    unsigned rts = SIM_P1(RTS_PIN);
+
+    sim_deadline(4 * RX_BUFFER_SIZE * FRAME_BITS * (BIT + 1));
+    CHECK_EQ(sim_level(rts), 0);
+    rx_frames(0x41, FLOW_HIGH - 1);
+    CHECK_EQ(sim_level(rts), 0);
+    rx_frames(0x41, 1);
+    CHECK_EQ(sim_level(rts), 1);
+
+    while (SoftSerial_available() > FLOW_LOW + 1) {
+        SoftSerial_read();
+    }
+    CHECK_EQ(sim_level(rts), 1);
+    SoftSerial_read();
+    CHECK_EQ(sim_level(rts), 0);
+#endif
+}
+
+/**
+ * flow_cts - CTS high holds TX between frames, the byte goes out once it drops
+ */
+
+static void test_flow_cts(void)
+{
+#if defined(SOFTSERIAL_RTSCTS)
+    unsigned cts = SIM_P1(CTS_PIN);
+    uint64_t go;
+    unsigned i;
+
+    sim_trace(TX);
+    sim_deadline(8 * FRAME_BITS * (BIT + 1));
+    sim_drive(cts, 1);
+    send(0x41);
+    run_to(sim.now + 3 * FRAME_BITS * BIT);
+    CHECK_EQ(sim_traced.n, 0);          // idle bits only
+
+    go = sim.now;
+    sim_drive(cts, 0);
+    i = start_bit(0);
+    CHECK(sim_traced.t[i] >= go);
+    CHECK(sim_traced.t[i] <= go + 3 * BIT + 64);   // the next look, then one idle bit ahead of the start bit
+    CHECK_EQ(traced_char(i), 0x41);
+    SoftSerial_flush();
+#endif
+}
+
+/**
+ * flow_xoff - XOFF goes out at FLOW_HIGH and XON at FLOW_LOW, a received XOFF holds TX until XON
+ */
+
+static void test_flow_xoff(void)
+{
+#if defined(SOFTSERIAL_XONXOFF)
+    unsigned i, n;
+
+    sim_trace(TX);
+    sim_deadline(8 * RX_BUFFER_SIZE * FRAME_BITS * (BIT + 1));
+
+    rx_frames(0x41, FLOW_HIGH - 1);
+    CHECK_EQ(sim_traced.n, 0);
+    rx_frames(0x41, 1);
+    SoftSerial_flush();
+    i = start_bit(0);
+    CHECK_EQ(traced_char(i), 0x13);
+    CHECK_EQ(grid_end(i, FRAME_BITS), 0);   // nothing after it
+
+    n = sim_traced.n;
+    while (SoftSerial_available() > FLOW_LOW + 1) {
+        SoftSerial_read();
+    }
+    SoftSerial_flush();
+    CHECK_EQ(sim_traced.n, n);
+    SoftSerial_read();
+    SoftSerial_flush();
+    i = start_bit(n);
+    CHECK_EQ(traced_char(i), 0x11);
+    while (SoftSerial_read() >= 0) {
+        ;
+    }
+
+    rx_frames(0x13, 1);                 // XOFF from the other side
+    CHECK_EQ(SoftSerial_available(), 0);
+    n = sim_traced.n;
+    send(0x41);
+    run_to(sim.now + 3 * FRAME_BITS * BIT);
+    CHECK_EQ(sim_traced.n, n);
+    rx_frames(0x11, 1);                 // XON
+    i = start_bit(n);
+    CHECK_EQ(traced_char(i), 0x41);
+    SoftSerial_flush();
+#endif
+}
+
+/**
+ * rs485_de - DE goes up a bit before the first start bit and drops right at the end of the last stop bit
+ */
+
+static void test_rs485_de(void)
+{
+#if defined(SOFTSERIAL_RS485)
+    unsigned de = SIM_P1(DE_PIN);
+    uint64_t on, end;
+    unsigned i;
+
+    sim_trace(TX);
+    sim_deadline(8 * FRAME_BITS * (BIT + 1));
+    CHECK_EQ(sim_level(de), 0);
+    send(0x41);
+    on = sim.now;
+    send(0x42);
+    CHECK_EQ(sim_level(de), 1);
+    while (sim_level(de)) {
+        sim_run(1);
+    }
+
+    i = start_bit(0);
+    CHECK(sim_traced.t[i] >= on + BIT - SIM_ACCESS_TICKS);
+    CHECK((i = grid_end(i, FRAME_BITS)));
+    CHECK_EQ(grid_end(i, FRAME_BITS), 0);
+    end = sim_traced.t[i] + (((uint64_t)FRAME_BITS * X16) >> 16);
+    CHECK(sim.now >= end);
+    CHECK(sim.now <= end + SIM_IRQ_ENTRY + 16 * SIM_ACCESS_TICKS);  // the TX ISR of that compare
+#endif
+}
+
+/**
+ * rs485_addr - frames for other nodes never reach the rx_buffer, ours and broadcasts do
+ */
+
+static void test_rs485_addr(void)
+{
+#if defined(SOFTSERIAL_RS485) && (DATA_BITS > 8 || SOFTSERIAL_FRAMING == 'G')
+#if DATA_BITS > 8
+    static const unsigned bus[] = { 0x106, 'x', 'y', 0x105, 'a', 'b', 0x107, 'z', 0x100, 'c' };
+    static const unsigned ours[] = { 0x105, 'a', 'b', 0x100, 'c' };
+#else
+    static const unsigned bus[][2] = { { 0x06, 'x' }, { 0x05, 'a' }, { 0x07, 'z' }, { 0x00, 'c' } };
+    static const unsigned ours[][2] = { { 0x05, 'a' }, { 0x00, 'c' } };
+    uint8_t buf[4];
+#endif
+    sim_gen_t g;
+    unsigned i;
+
+    sim_deadline(40 * FRAME_BITS * (BIT + 1) + 0x10000);
+    SoftSerial_address(0x05, 0x00);
+    sim_gen_start(&g, RX, X16, BIT);
+#if DATA_BITS > 8
+    for (i = 0; i < sizeof(bus) / sizeof(bus[0]); ++i) {
+        sim_gen_bits(&g, frame(bus[i], 1, 1), FRAME_BITS);
+    }
+    run_to(sim_gen_done(&g) + BIT);
+    for (i = 0; i < sizeof(ours) / sizeof(ours[0]); ++i) {
+        CHECK_EQ(SoftSerial_read(), ours[i]);
+    }
+    CHECK_EQ(SoftSerial_read(), -1);
+#else
+    for (i = 0; i < sizeof(bus) / sizeof(bus[0]); ++i) {
+        sim_gen_bits(&g, frame(bus[i][0], 1, 1), FRAME_BITS);
+        sim_gen_bits(&g, frame(bus[i][1], 1, 1), FRAME_BITS);
+        sim_gen_hold(&g, 1, 6 * FRAME_BITS * BIT);  // more than the 3.5 character gap
+    }
+    run_to(sim_gen_done(&g));
+    for (i = 0; i < sizeof(ours) / sizeof(ours[0]); ++i) {
+        CHECK_EQ(SoftSerial_frame_read(buf, sizeof(buf)), 2);
+        CHECK_EQ(buf[0], ours[i][0]);
+        CHECK_EQ(buf[1], ours[i][1]);
+    }
+    CHECK_EQ(SoftSerial_frame_available(), 0);
+#endif
+#endif
+}
+
+#if defined(SOFTSERIAL_RECEIVE)
+static unsigned recv_calls, recv_count;
+
+static void on_receive(unsigned n)
+{
+    ++recv_calls;
+    recv_count = n;
+}
+#endif
+
+/**
+ * receive_into - the RX ISR fills the caller's buffer, reports the count once and leaves the rx_buffer alone
+ */
+
+static void test_receive_into(void)
+{
+#if defined(SOFTSERIAL_RECEIVE)
+    uint8_t buf[8];
+
+    sim_deadline(40 * FRAME_BITS * (BIT + 1) + 16 * TIMER_TICKS);
+    recv_calls = 0;
+    memset(buf, 0, sizeof(buf));
+
+    rx_gen(RX, "pq");                   // already waiting, moved over first
+    SoftSerial_receive_into(buf, 6, 0, on_receive);
+    CHECK_EQ(SoftSerial_available(), 0);
+    CHECK_EQ(SoftSerial_receive_done(), -1);
+
+    rx_gen(RX, "abc");
+    CHECK_EQ(SoftSerial_available(), 0);
+    CHECK_EQ(SoftSerial_receive_done(), -1);
+    CHECK_EQ(recv_calls, 0);
+
+    rx_gen(RX, "def");                  // d fills it, e and f go to the rx_buffer
+    CHECK_EQ(recv_calls, 1);
+    CHECK_EQ(recv_count, 6);
+    CHECK_EQ(SoftSerial_receive_done(), 6);
+    CHECK(!memcmp(buf, "pqabcd", 6));
+    CHECK_EQ(buf[6], 0);
+    CHECK_EQ(SoftSerial_available(), 2);
+    CHECK_EQ(SoftSerial_read(), 'e');
+    CHECK_EQ(SoftSerial_read(), 'f');
+
+    SoftSerial_receive_into(buf, sizeof(buf), 0, 0);
+    rx_gen(RX, "xy");
+    SoftSerial_receive_stop();
+    CHECK_EQ(SoftSerial_receive_done(), 2);
+    CHECK_EQ(recv_calls, 1);            // fn was 0 this time
+    rx_gen(RX, "z");
+    CHECK_EQ(SoftSerial_read(), 'z');
+
+#if defined(SOFTSERIAL_TIMERS)
+    SoftSerial_receive_into(buf, sizeof(buf), 3, on_receive);
+    rx_gen(RX, "t");
+    run_to(sim.now + TIMER_TICKS);      // the byte started the timeout over
+    CHECK_EQ(SoftSerial_receive_done(), -1);
+    run_to(sim.now + 2 * TIMER_TICKS);  // 3 ticks without a byte
+    CHECK_EQ(SoftSerial_receive_done(), 1);
+    CHECK_EQ(recv_calls, 2);
+    CHECK_EQ(recv_count, 1);
+    CHECK_EQ(buf[0], 't');
+#endif
+#endif
+}
+
+#if defined(SOFTSERIAL_TIMERS)
+
+static unsigned timer_calls;
+static uint64_t timer_last;             // when on_timer() ran last
+
+static unsigned on_timer(void)
+{
+    if (timer_calls++) {
+        uint64_t d = sim.now - timer_last;
+
+        if (d + BIT + 64 < TIMER_TICKS || d > TIMER_TICKS + BIT + 64) {
+            sim_fail("tick %u came after %llu ticks", timer_calls, (unsigned long long)d);
+        }
+    }
+    timer_last = sim.now;
+    return 0;
+}
+#endif
+
+#if defined(SOFTSERIAL_PRINT) && !defined(SOFTSERIAL_FRAMING) && !defined(SOFTSERIAL_RS485)
+
+/**
+ * printed() - the loopback has to bring back exactly want
+ */
+
+static void printed(const char *want)
+{
+    char got[40];
+    unsigned n = 0, len = strlen(want);
+    uint64_t end = sim.now + (len + 2) * FRAME_BITS * (BIT + 1);
+    int c;
+
+    while (n < len && sim.now < end) {
+        if ((c = SoftSerial_read()) >= 0) {
+            got[n++] = c;
+        }
+        else {
+            sim_run(BIT);
+        }
+    }
+    got[n] = 0;
+    run_to(sim.now + 2 * FRAME_BITS * BIT);
+    if (n != len || memcmp(got, want, len) || SoftSerial_available()) {
+        sim_fail("printed \"%s\", expected \"%s\"", got, want);
+    }
+}
+#endif
+
+/**
+ * print - softserial_print.c at the ends of its ranges, padded and rounded
+ */
+
+static void test_print(void)
+{
+#if defined(SOFTSERIAL_PRINT) && !defined(SOFTSERIAL_FRAMING) && !defined(SOFTSERIAL_RS485)
+    sim_wire(TX, RX);
+    sim_deadline(200 * FRAME_BITS * (BIT + 1));
+
+    SoftSerial_print_dec(INT32_MIN, 0);
+    printed("-2147483648");
+    SoftSerial_print_dec(INT32_MAX, 0);
+    printed("2147483647");
+    SoftSerial_print_udec(0xFFFF, 0);
+    printed("65535");
+    SoftSerial_print_udec(0x10000, 0);
+    printed("65536");
+    SoftSerial_print_udec(0xFFFFFFFF, 0);
+    printed("4294967295");
+    SoftSerial_print_udec(0, 0);
+    printed("0");
+
+    SoftSerial_print_hex(0, 0);
+    printed("0");
+    SoftSerial_print_hex(0x1AF, 0);
+    printed("1AF");
+    SoftSerial_print_hex(0xDEADBEEF, 0);
+    printed("DEADBEEF");
+    SoftSerial_print_hex(0x1AF, 4);
+    printed("01AF");
+
+    SoftSerial_print_dec(42, 6);
+    printed("    42");
+    SoftSerial_print_dec(-42, 6 | SOFTSERIAL_FMT_ZERO);
+    printed("-00042");
+    SoftSerial_print_dec(42, 6 | SOFTSERIAL_FMT_LEFT);
+    printed("42    ");
+    SoftSerial_print_dec(42, 4 | SOFTSERIAL_FMT_PLUS);
+    printed(" +42");
+    SoftSerial_print_udec(123456, 3);   // never cut
+    printed("123456");
+
+    SoftSerial_print_fixed(65529, 16, 3, 0);    // 0.9999 rounds into the integer part
+    printed("1.000");
+    SoftSerial_print_fixed(-65529, 16, 3, 7);
+    printed(" -1.000");
+    SoftSerial_print_fixed(0x1780, 8, 2, 7);
+    printed("  23.50");
+    SoftSerial_print_fixed(0x1780, 8, 0, 0);    // 23.5, halves round away from 0
+    printed("24");
+#endif
+}
+
+/**
+ * stamps - SoftSerial_stamp() is the Timer_A time of each start bit the generator sent
+ */
+
+static void test_stamps(void)
+{
+#if defined(SOFTSERIAL_STAMPS) && !defined(SOFTSERIAL_FRAMING)
+    uint16_t edge[8];
+    unsigned i;
+
+    sim_deadline(40 * FRAME_BITS * (BIT + 1));
+    for (i = 0; i < 8; ++i) {           // uneven gaps, TA0R wraps on the way
+        uint16_t base = (uint16_t)sim.now - sim.ta[0].r;
+        sim_gen_t g;
+
+        sim_gen_start(&g, RX, X16, BIT + 37 * i);
+        edge[i] = (uint16_t)(sim.now + BIT + 37 * i) - base;
+        sim_gen_bits(&g, frame(0x30 + i, 1, 1), FRAME_BITS);
+        sim_gen_bits(&g, ~0u, 4 * i);
+        run_to(sim_gen_done(&g));
+    }
+    for (i = 0; i < 8; ++i) {           // each slot keeps its own
+        int16_t err;
+
+        CHECK(SoftSerial_available());
+        err = SoftSerial_stamp() - edge[i];
+        if (err < -1 || err > 1) {
+            sim_fail("stamp %u is %d ticks off its start bit", i, err);
+        }
+        CHECK(SoftSerial_read() == 0x30 + (int)i);
+    }
+#endif
+}
+
+/**
+ * timers - a periodic timer runs on the shared CCRs through back to back TX and RX
+ *
+ * The frames keep their bit grid, every byte comes back and each tick
+ * is at most a bit late.
+ */
+
+static void test_timers(void)
+{
+#if defined(SOFTSERIAL_TIMERS) && !defined(SOFTSERIAL_FRAMING)
+    unsigned sent = 0, got = 0, frames = 0, i;
+    uint64_t t0;
+
+    sim_wire(TX, RX);
+    sim_trace(TX);
+    sim_deadline(80 * FRAME_BITS * (BIT + 1) + 4 * TIMER_TICKS);
+
+    timer_calls = 0;
+    t0 = sim.now;
+    SoftSerial_timer_start(0, 1, 1, on_timer);
+    while (got < 64) {
+        int c;
+
+        if (sent < 64 && SoftSerial_tx_free()) {
+            send(sent++ * 37);
+        }
+        if ((c = SoftSerial_read()) >= 0) {
+            CHECK_EQ(c, (got * 37) & DATA_MASK);
+            ++got;
+        }
+        sim_run(1);
+    }
+    SoftSerial_flush();
+    SoftSerial_timer_stop(0);
+    CHECK(timer_calls + 1 >= (sim.now - t0) / TIMER_TICKS);
+
+    i = start_bit(0);
+    do {
+        ++frames;
+    } while ((i = grid_end(i, FRAME_BITS)));
+    CHECK_EQ(frames, 64);
+#if defined(SOFTSERIAL_STATS)
+    CHECK_EQ(stats().framing, 0);
+#endif
+#endif
+}
+
+static const test_t tests[] = {
+    { "loopback",   test_loopback },
+    { "tx_timing",  test_tx_timing },
+    { "tx_gap",     test_tx_gap },
+    { "receive",    test_receive },
+    { "skew",       test_skew },
+    { "framing",    test_framing },
+    { "parity",     test_parity },
+    { "break_rx",   test_break_rx },
+    { "break_tx",   test_break_tx },
+    { "break_stale", test_break_stale },
+    { "line_idle",  test_line_idle },
+    { "dco_end",    test_dco_end },
+    { "port_loopback", test_port_loopback },
+    { "port_gap",   test_port_gap },
+    { "stale_edge", test_stale_edge },
+    { "port_bridge", test_port_bridge },
+    { "bridge_echo", test_bridge_echo },
+    { "bridge_port", test_bridge_port },
+    { "lpm3_idle",  test_lpm3_idle },
+    { "spans",      test_spans },
+    { "set_baud",   test_set_baud },
+    { "timers",     test_timers },
+    { "receive_into", test_receive_into },
+    { "print",      test_print },
+    { "stamps",     test_stamps },
+    { "frames",     test_frames },
+    { "flow_rts",   test_flow_rts },
+    { "flow_cts",   test_flow_cts },
+    { "flow_xoff",  test_flow_xoff },
+    { "rs485_de",   test_rs485_de },
+    { "rs485_addr", test_rs485_addr },
+};
+
+/**
+ * run() - one test in a child process on a reset chip, 0 if it passed
+ */
+
+static int run(const test_t *t)
+{
+    pid_t pid;
+    int status;
+
+    fflush(stdout);
+    pid = fork();
+    if (pid < 0) {
+        perror("fork");
+        exit(2);
+    }
+    if (!pid) {
+        alarm(120);                     // a busy loop that never touches a register
+        sim_reset(F_CPU);
+#if defined(SOFTSERIAL_RTSCTS)
+        sim_drive(SIM_P1(CTS_PIN), 0);  // no pull down in the sim, the other side lets us send
+#endif
+        SoftSerial_init();
+        __enable_interrupt();
+#if defined(SOFTSERIAL_STATS)
+        SoftSerial_clear_stats();
+#endif
+        sim_run(2 * FRAME_BITS * BIT);  // the line has been idle a while
+        t->fn();
+        exit(0);
+    }
+    waitpid(pid, &status, 0);
+    if (WIFSIGNALED(status)) {
+        printf("    FAIL: signal %d\n", WTERMSIG(status));
+    }
+    return !(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+}
+
+int main(int argc, char *argv[])
+{
+    unsigned i, failed = 0;
+
+    for (i = 0; i < sizeof(tests)/sizeof(tests[0]); ++i) {
+        if (argc > 1 && !strstr(tests[i].name, argv[1])) {
+            continue;
+        }
+        printf("  %s\n", tests[i].name);
+        if (run(&tests[i])) {
+            ++failed;
+        }
+    }
+    return failed ? 1 : 0;
+}
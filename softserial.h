@@ -22,14 +22,178 @@
 extern "C" {
 #endif
 
+/**
+ * SOFTSERIAL_ISR() - declare an interrupt handler for msp430-gcc or CCS/IAR.
+ *
+ * Define it before softserial.h is included to build the ISRs some other way.
+ * A host build against a stand-in msp430.h can use plain functions and call
+ * the handlers from a simulated timer:
+ *
+ *   -D'SOFTSERIAL_ISR(vec,name)=void name(void)'
+ */
+#ifndef SOFTSERIAL_ISR
+#ifndef __GNUC__
+#define SOFTSERIAL_PRAGMA(x) _Pragma(#x)
+#define SOFTSERIAL_ISR(vec,name) SOFTSERIAL_PRAGMA(vector = vec) __interrupt void name(void)
+#else
+#define SOFTSERIAL_ISR(vec,name) __attribute__((interrupt(vec))) void name(void)
+#endif
+#endif /* SOFTSERIAL_ISR */
+
 void SoftSerial_init(void);
 void SoftSerial_end(void);
 
 unsigned SoftSerial_available(void);
 unsigned SoftSerial_empty(void);
 void SoftSerial_xmit(unsigned char);
+#if defined(SOFTSERIAL_DATA_BITS) && SOFTSERIAL_DATA_BITS > 8
+void SoftSerial_xmit9(unsigned);    // SoftSerial_read() returns all 9 bits, read_nc() only the low 8
+#endif
+unsigned SoftSerial_tx_free(void);
+void SoftSerial_flush(void);
+unsigned SoftSerial_idle(void);
+unsigned SoftSerial_rx_skew(void);  // sender clock error we still decode, in 1/1000
 int SoftSerial_read(void);
 unsigned char SoftSerial_read_nc(void);
+unsigned SoftSerial_read_block(unsigned char *buf, unsigned n);
+unsigned SoftSerial_write_block(const unsigned char *buf, unsigned n);
+unsigned SoftSerial_put(unsigned char c); // xmit() for ISRs, 0 if the tx_buffer is full
+
+#if defined(SOFTSERIAL_BRIDGE)
+#define SOFTSERIAL_BRIDGE_OFF  0    // received bytes go to the rx_buffer
+#define SOFTSERIAL_BRIDGE_ECHO 1    // straight into our own tx_buffer
+#define SOFTSERIAL_BRIDGE_PORT 2    // into the tx_buffer of a softserial_port.c port
+#define SOFTSERIAL_BRIDGE_MAIN 3    // ports only, into the softserial.c tx_buffer
+
+/**
+ * SOFTSERIAL_BRIDGE_PASSES() - true if the 32 byte pass bitmap lets c through
+ */
+#define SOFTSERIAL_BRIDGE_PASSES(pass, c) ((pass)[(uint8_t)(c) >> 3] & (1 << ((c) & 7)))
+
+struct SoftSerial_t;
+void SoftSerial_bridge(unsigned mode, struct SoftSerial_t *to, const unsigned char *xlat, const unsigned char *pass);
+#endif
+
+/**
+ * SOFTSERIAL_SPANS - the ring buffers hold plain bytes, so they can be read
+ *                    and filled in place. Not with 9 data bits or 8 plus parity.
+ */
+#if !defined(SOFTSERIAL_PARITY) || SOFTSERIAL_PARITY == 'N'
+#if !defined(SOFTSERIAL_DATA_BITS) || SOFTSERIAL_DATA_BITS <= 8
+#define SOFTSERIAL_SPANS
+#endif
+#elif defined(SOFTSERIAL_DATA_BITS) && SOFTSERIAL_DATA_BITS < 8    // 8 is the default
+#define SOFTSERIAL_SPANS
+#endif
+
+#if defined(SOFTSERIAL_SPANS)
+
+/**
+ * SoftSerial_span_t - a contiguous piece of a ring buffer
+ */
+typedef struct {
+    unsigned char *data;
+    unsigned len;
+} SoftSerial_span_t;
+
+unsigned SoftSerial_rx_peek(SoftSerial_span_t span[2]);
+void SoftSerial_rx_commit(unsigned n);
+unsigned SoftSerial_tx_reserve(SoftSerial_span_t span[2]);
+void SoftSerial_tx_commit(unsigned n);
+#endif
+
+#if defined(SOFTSERIAL_FRAMING)
+unsigned SoftSerial_frame_available(void);
+unsigned SoftSerial_frame_read(unsigned char *buf, unsigned max);
+#if SOFTSERIAL_FRAMING != 'G'
+void SoftSerial_frame_write(const unsigned char *buf, unsigned n);
+#endif
+#endif
+
+#if defined(SOFTSERIAL_STAMPS)
+uint16_t SoftSerial_stamp(void);
+#endif
+
+#if defined(SOFTSERIAL_RECEIVE)
+typedef void (*SoftSerial_receive_fn)(unsigned n);  // runs in the ISR, the transfer got n bytes
+
+void SoftSerial_receive_into(unsigned char *buf, unsigned len, unsigned timeout, SoftSerial_receive_fn fn);
+int SoftSerial_receive_done(void);  // -1 while the transfer runs, then its byte count
+void SoftSerial_receive_stop(void);
+#endif
+
+#if defined(SOFTSERIAL_BREAK)
+#define SOFTSERIAL_LINE_BREAK 1     // the line was 0 through the stop bit, nothing was stored
+#define SOFTSERIAL_LINE_IDLE  2     // the line has been idle for idle_bits after a stop bit
+
+typedef unsigned (*SoftSerial_line_fn)(unsigned event);    // runs in the RX ISR, non zero ends SoftSerial_sleep()
+
+void SoftSerial_line_events(SoftSerial_line_fn fn, unsigned idle_bits);
+void SoftSerial_send_break(unsigned bits);
+#endif
+
+#if defined(SOFTSERIAL_RS485) && (defined(SOFTSERIAL_DATA_BITS) && SOFTSERIAL_DATA_BITS > 8 \
+    || defined(SOFTSERIAL_FRAMING) && SOFTSERIAL_FRAMING == 'G')
+void SoftSerial_address(int addr, int broadcast);   // -1, -1 takes every frame
+#endif
+
+#if defined(SOFTSERIAL_TIMERS)
+typedef unsigned (*SoftSerial_timer_fn)(void);  // runs in the ISR, non zero ends SoftSerial_sleep()
+
+void SoftSerial_timer_start(unsigned id, unsigned ticks, unsigned period, SoftSerial_timer_fn fn);
+void SoftSerial_timer_stop(unsigned id);
+unsigned SoftSerial_timer_left(unsigned id);
+#endif
+
+#if defined(SOFTSERIAL_RUNTIME_BAUD)
+unsigned long SoftSerial_set_baud(unsigned long baud);
+unsigned long SoftSerial_baud(void);
+#if !defined(SOFTSERIAL_RX_EDGES) && !defined(SOFTSERIAL_USCI)
+void SoftSerial_autobaud(void);
+#endif
+#endif
+
+#if defined(SOFTSERIAL_RUNTIME_BAUD) || defined(SOFTSERIAL_PORTS)
+uint32_t SoftSerial_ticks_x16(unsigned long baud);
+#endif
+
+#if defined(SOFTSERIAL_LOWPOWER)
+void SoftSerial_wake_on(unsigned rx_count, int rx_delimiter, unsigned tx_empty);
+void SoftSerial_sleep(void);
+#endif
+
+#if defined(SOFTSERIAL_STATS)
+#define SOFTSERIAL_LATENCY_BINS 8   // ISR latency histogram size
+#define SOFTSERIAL_LATENCY_BIN0 16  // width of the first bin in timer ticks, each bin after is twice as wide
+
+/**
+ * SoftSerial_stats_t - error counters and ISR timing, all 16 bit and wrap around
+ *
+ * latency[] counts ISR entries by how many timer ticks after the
+ * scheduled compare time or the captured edge they ran: <16, <32,
+ * <64 ... and the last bin has everything else. busy_max is the
+ * latest an ISR ever finished, due time to exit. With SMCLK == MCLK
+ * ticks are CPU cycles. If busy_max gets near a bit time the ISRs are
+ * overloaded, a steady stream of overruns means the rx_buffer is too
+ * small or the main loop is too slow, framing errors with neither of
+ * those point at clock drift.
+ */
+typedef struct {
+    uint16_t overrun;       // bytes dropped, the rx_buffer was full
+    uint16_t framing;       // stop bit was a 0
+    uint16_t brk;           // all 0 data and a 0 stop bit, someone is holding the line low
+    uint16_t noise;         // start bit was over before we could look at it
+    uint16_t parity;        // parity bit was wrong, the character was dropped
+    uint16_t badframe;      // SOFTSERIAL_FRAMING frames dropped, bad CRC or encoding
+    uint16_t bridge;        // SOFTSERIAL_BRIDGE bytes dropped, the target tx_buffer was full
+    uint16_t latency_max;   // worst ISR entry latency
+    uint16_t busy_max;      // worst ISR exit time
+    uint16_t latency[SOFTSERIAL_LATENCY_BINS];
+} SoftSerial_stats_t;
+
+void SoftSerial_get_stats(SoftSerial_stats_t *copy);
+void SoftSerial_clear_stats(void);
+#endif
 
 //------------------------------------------------------------
 // TX/RX PINS - you can't really change these as we use the
@@ -39,6 +203,34 @@ unsigned char SoftSerial_read_nc(void);
 #define TX_PIN BIT1     // TX Data on P1.1 (Timer0_A.OUT0)
 #define RX_PIN BIT2     // RX Data on P1.2 (Timer0_A.CCI1A)
 
+//------------------------------------------------------------
+// USCI PINS - SOFTSERIAL_USCI, fixed by the chip. RX and TX are
+// the other way around from the Timer_A pins, on a launchpad
+// turn the RXD/TXD jumpers to the HW UART position.
+//------------------------------------------------------------
+#define USCI_TX_PIN BIT2    // UCA0TXD on P1.2
+#define USCI_RX_PIN BIT1    // UCA0RXD on P1.1
+
+//------------------------------------------------------------
+// RTS/CTS PINS - any spare P1 GPIO, only with SOFTSERIAL_RTSCTS.
+// Both active low. CTS has a pull down, left open it means go.
+//------------------------------------------------------------
+#ifndef RTS_PIN
+#define RTS_PIN BIT5    // RTS out on P1.5, high asks the other side to stop
+#endif
+#ifndef CTS_PIN
+#define CTS_PIN BIT7    // CTS in on P1.7, high holds our TX between frames
+#endif
+
+//------------------------------------------------------------
+// RS-485 DE PIN - any spare P1 GPIO, only with SOFTSERIAL_RS485.
+// Active high, wire it to DE, and /RE to DE or to ground. The
+// default is the RTS pin, RS-485 adapters drive DE from RTS too.
+//------------------------------------------------------------
+#ifndef DE_PIN
+#define DE_PIN BIT5     // DE out on P1.5, high while we drive the bus
+#endif
+
 #ifdef __cplusplus
 } /* extern "C" */
 #endif
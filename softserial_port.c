@@ -0,0 +1,428 @@
+/**
+ * softserial_port.c - extra software UART ports on Timer1_A3 (msp430g2553)
+ *
+ * Same bit engine as softserial.c, but every register and buffer is
+ * reached through a SoftSerial_t so one pair of ISRs serves all ports.
+ * TIMER1_A0 is CCR0, TIMER1_A1 dispatches CCR1 and CCR2 on TA1IV.
+ * See softserial_port.h for pins and throughput limits.
+ *
+ * License: Do with this code what you want. However, don't blame
+ * me if you connect it to a heart pump and it stops.  This source
+ * is provided as is with no warranties. It probably has bugs!!
+ * You have been warned!
+ *
+ * Author: Rick Kimball
+ * email: rick@kimballsoftware.com
+ */
+
+#include <msp430.h>
+#include <stdint.h>
+#include "config.h"
+#include "softserial.h"
+#include "softserial_port.h"
+
+#if defined(SOFTSERIAL_PORTS)
+
+#if !defined(__MSP430_HAS_T1A3__)
+    #error SOFTSERIAL_PORTS needs Timer1_A3, use a chip like the msp430g2553
+#endif
+
+#if SOFTSERIAL_PORT_BUFFER_SIZE & (SOFTSERIAL_PORT_BUFFER_SIZE - 1)
+    #error SOFTSERIAL_PORT_BUFFER_SIZE must be a power of 2
+#endif
+
+#define PORT_BUFFER_MASK (SOFTSERIAL_PORT_BUFFER_SIZE - 1)
+
+#define STOPBITS_1 0x0100
+
+//--------------------------------------------------------------------------------
+// F I L E   G L O B A L S
+//--------------------------------------------------------------------------------
+
+static SoftSerial_t *ccr_port[3];       // which port owns TA1CCR0-2
+
+static inline void port_tx_load(SoftSerial_t *port);
+
+//--------------------------------------------------------------------------------
+// E X P O S E D   E X T E R N A L   F U N C T I O N S
+//--------------------------------------------------------------------------------
+
+/**
+ * SoftSerial_port_init() - work out the bit timing, configure pins and CCRs
+ *
+ * The first port to start also starts Timer1_A3 in continuous mode.
+ */
+
+void SoftSerial_port_init(SoftSerial_t *port, unsigned long baud)
+{
+    static volatile uint16_t * const cctl[3] = { &TA1CCTL0, &TA1CCTL1, &TA1CCTL2 };
+    static volatile uint16_t * const ccr[3] = { &TA1CCR0, &TA1CCR1, &TA1CCR2 };
+    uint32_t x16 = SoftSerial_ticks_x16(baud);
+
+    port->bit_ticks = x16 >> 16;
+    port->bit_frac = x16;
+    x16 += x16 / 2 + 0x8000;            // 1.5 bits, rounded
+    port->first_ticks = x16 >> 16;
+    port->first_frac = x16;
+
+    port->rx_buffer.head = port->rx_buffer.tail = 0;
+    port->tx_buffer.head = port->tx_buffer.tail = 0;
+    port->tx_drain = 0;
+#if defined(SOFTSERIAL_BRIDGE)
+    port->bridge_mode = SOFTSERIAL_BRIDGE_OFF;
+#endif
+
+    if (!(TA1CTL & MC_2)) {
+        TA1CTL = TASSEL_2 | MC_2 | TACLR;   // Clock TIMER1_A from SMCLK, continuous mode
+    }
+
+    if (port->tx_ccr != SOFTSERIAL_NONE) {
+        port->tx_cctl = cctl[port->tx_ccr];
+        port->tx_ccr_reg = ccr[port->tx_ccr];
+        ccr_port[port->tx_ccr] = port;
+
+        P2OUT |= port->tx_pin;
+        P2SEL |= port->tx_pin;          // Enable Timer alternate functionality
+        P2DIR |= port->tx_pin;
+        *port->tx_cctl = OUT;           // Set TXD Idle state as Mark = '1'
+    }
+
+    if (port->rx_ccr != SOFTSERIAL_NONE) {
+        port->rx_cctl = cctl[port->rx_ccr];
+        port->rx_ccr_reg = ccr[port->rx_ccr];
+        ccr_port[port->rx_ccr] = port;
+
+        P2OUT |= port->rx_pin;
+        P2SEL |= port->rx_pin;
+        *port->rx_cctl = port->rx_ccis | SCS | CM1 | CAP | CCIE; // Detect Neg Edge, Capture mode
+    }
+}
+
+/**
+ * SoftSerial_port_end() - flush, release the CCRs and pins. Stops Timer1_A3 when no port is left
+ */
+
+void SoftSerial_port_end(SoftSerial_t *port)
+{
+    if (port->tx_ccr != SOFTSERIAL_NONE) {
+        SoftSerial_port_flush(port);
+        P2SEL &= ~port->tx_pin;
+        P2DIR &= ~port->tx_pin;
+        *port->tx_cctl = 0;
+        ccr_port[port->tx_ccr] = 0;
+    }
+
+    if (port->rx_ccr != SOFTSERIAL_NONE) {
+        P2SEL &= ~port->rx_pin;
+        *port->rx_cctl = 0;
+        ccr_port[port->rx_ccr] = 0;
+    }
+
+    if (!ccr_port[0] && !ccr_port[1] && !ccr_port[2]) {
+        TA1CTL = 0;
+    }
+}
+
+/**
+ * SoftSerial_port_available() - returns the number of characters in the RX ring buffer
+ */
+
+unsigned SoftSerial_port_available(SoftSerial_t *port)
+{
+    return (port->rx_buffer.head - port->rx_buffer.tail) & PORT_BUFFER_MASK;
+}
+
+/**
+ * SoftSerial_port_empty() - returns true if the RX ring buffer is empty
+ */
+
+unsigned SoftSerial_port_empty(SoftSerial_t *port)
+{
+    return port->rx_buffer.head == port->rx_buffer.tail;
+}
+
+/**
+ * SoftSerial_port_read() - remove an RX character from the ring buffer, -1 if none
+ */
+
+int SoftSerial_port_read(SoftSerial_t *port)
+{
+    register unsigned temp_tail = port->rx_buffer.tail;
+
+    if (port->rx_buffer.head != temp_tail) {
+        uint8_t c = port->rx_buffer.buffer[temp_tail++];
+        port->rx_buffer.tail = temp_tail & PORT_BUFFER_MASK;
+        return c;
+    }
+    else {
+        return -1;
+    }
+}
+
+/**
+ * SoftSerial_port_tx_free() - returns the number of free slots in the TX ring buffer
+ */
+
+unsigned SoftSerial_port_tx_free(SoftSerial_t *port)
+{
+    return PORT_BUFFER_MASK - ((port->tx_buffer.head - port->tx_buffer.tail) & PORT_BUFFER_MASK);
+}
+
+/**
+ * SoftSerial_port_flush() - wait until the TX ring buffer is empty and the last stop bit is out
+ */
+
+void SoftSerial_port_flush(SoftSerial_t *port)
+{
+    if (port->tx_ccr == SOFTSERIAL_NONE) {
+        return;                         // receive only, nothing to wait for
+    }
+    while (*port->tx_cctl & CCIE) {
+        __no_operation();       // port_tx_bit() lets go at the end of the stop bit
+    }
+}
+
+/**
+ * SoftSerial_port_xmit() - queue one byte of data, see SoftSerial_xmit()
+ */
+
+void SoftSerial_port_xmit(SoftSerial_t *port, uint8_t c)
+{
+    register unsigned head = port->tx_buffer.head;
+    register unsigned next_head = (head + 1) & PORT_BUFFER_MASK;
+
+    while (next_head == port->tx_buffer.tail) {
+        __no_operation();       // tx_buffer full, wait for the TX ISR to make room
+    }
+
+    port->tx_buffer.buffer[head] = c;
+    port->tx_buffer.head = next_head;
+
+    port_tx_load(port);
+}
+
+/**
+ * SoftSerial_port_put() - queue one byte from an ISR, never waits, see SoftSerial_put()
+ */
+
+unsigned SoftSerial_port_put(SoftSerial_t *port, uint8_t c)
+{
+    register unsigned head = port->tx_buffer.head;
+    register unsigned next_head = (head + 1) & PORT_BUFFER_MASK;
+
+    if (next_head == port->tx_buffer.tail) {
+        return 0;
+    }
+
+    port->tx_buffer.buffer[head] = c;
+    port->tx_buffer.head = next_head;
+
+    port_tx_load(port);
+    return 1;
+}
+
+#if defined(SOFTSERIAL_BRIDGE)
+
+/**
+ * SoftSerial_port_bridge() - forward what the port receives from its RX ISR, see SoftSerial_bridge()
+ *
+ * SOFTSERIAL_BRIDGE_ECHO sends it back out of the same port,
+ * SOFTSERIAL_BRIDGE_PORT out of port 'to' and SOFTSERIAL_BRIDGE_MAIN
+ * out of the softserial.c TX pin. Full target tx_buffers drop the byte.
+ * A target without TX, 'to' or the port itself for ECHO, turns it off.
+ */
+
+void SoftSerial_port_bridge(SoftSerial_t *port, unsigned mode, SoftSerial_t *to,
+                            const uint8_t *xlat, const uint8_t *pass)
+{
+    __disable_interrupt();
+    port->bridge_xlat = xlat;
+    port->bridge_pass = pass;
+    if (mode == SOFTSERIAL_BRIDGE_ECHO) {
+        to = port;
+        mode = SOFTSERIAL_BRIDGE_PORT;
+    }
+    if (mode == SOFTSERIAL_BRIDGE_PORT && (!to || to->tx_ccr == SOFTSERIAL_NONE)) {
+        mode = SOFTSERIAL_BRIDGE_OFF;   // nowhere to send it, port_tx_load() needs a tx_cctl
+    }
+    port->bridge_to = to;
+    port->bridge_mode = mode;
+    __enable_interrupt();
+}
+
+#endif
+
+//--------------------------------------------------------------------------------
+// I N T E R N A L   F U N C T I O N S
+//--------------------------------------------------------------------------------
+
+/**
+ * port_tx_load() - start the TX ISR of the port if it is idle, see tx_start()
+ */
+
+static inline void port_tx_load(SoftSerial_t *port)
+{
+    if (!(*port->tx_cctl & CCIE)) {
+        register unsigned tail = port->tx_buffer.tail;
+
+        port->txbits = (port->tx_buffer.buffer[tail] | STOPBITS_1) << 1;
+        port->tx_buffer.tail = (tail + 1) & PORT_BUFFER_MASK;
+
+        *port->tx_ccr_reg = TA1R + port->bit_ticks;     // resync with the counter, idle one bit first
+        port->tx_frac = 0x8000;                         // round the edges, see tx_load()
+        *port->tx_cctl = OUTMOD0 | CCIE;                // set TX pin HIGH on EQU and enable interrupts
+    }
+}
+
+#if defined(SOFTSERIAL_BRIDGE)
+
+/**
+ * port_bridge_rx() - RX ISR, filter, translate and forward one byte
+ */
+
+static void port_bridge_rx(SoftSerial_t *port, uint8_t c)
+{
+    if (port->bridge_pass && !SOFTSERIAL_BRIDGE_PASSES(port->bridge_pass, c)) {
+        return;
+    }
+    if (port->bridge_xlat) {
+        c = port->bridge_xlat[c];
+    }
+    if (port->bridge_mode == SOFTSERIAL_BRIDGE_MAIN) {
+        SoftSerial_put(c);          // no stats on the ports, a full tx_buffer drops the byte
+    }
+    else {
+        SoftSerial_port_put(port->bridge_to, c);
+    }
+}
+
+#endif
+
+/**
+ * port_tx_bit() - send the next bit, see SoftSerial_TX_ISR
+ */
+
+static void port_tx_bit(SoftSerial_t *port)
+{
+    register volatile uint16_t *cctl = port->tx_cctl;
+
+    *port->tx_ccr_reg += port->bit_ticks;
+    if ((port->tx_frac += port->bit_frac) < port->bit_frac) {
+        ++*port->tx_ccr_reg;
+    }
+
+    *cctl |= OUTMOD2;                   // reset OUT (set to 0) OUTMOD2|OUTMOD0 (0b101)
+    if (port->txbits & 0x01) {
+        *cctl &= ~OUTMOD2;              // set OUT (set to 1) OUTMOD0 (0b001)
+    }
+
+    if (!(port->txbits >>= 1)) {        // All data bits transmitted ?
+        register unsigned tail = port->tx_buffer.tail;
+
+        if (port->tx_buffer.head != tail) {
+            port->txbits = (port->tx_buffer.buffer[tail] | STOPBITS_1) << 1;
+            port->tx_buffer.tail = (tail + 1) & PORT_BUFFER_MASK;
+            port->tx_drain = 0;
+        }
+        else if (!port->tx_drain) {
+            port->txbits = 0x0003;      // the stop bit goes out next, two idle bits bring us back at its end
+            port->tx_drain = 1;
+        }
+        else {
+            port->tx_drain = 0;
+            *cctl &= ~CCIE;             // disable interrupt, indicates we are done
+        }
+    }
+}
+
+/**
+ * port_rx_bit() - handle a start bit capture or a data bit sample, see SoftSerial_RX_ISR
+ */
+
+static void port_rx_bit(SoftSerial_t *port)
+{
+    register volatile uint16_t *cctl = port->rx_cctl;
+    register uint16_t regCCTL = *cctl;
+
+    if (regCCTL & CAP) {                // start bit, sample next in the middle of the first data bit
+        *port->rx_ccr_reg += port->first_ticks;
+        port->rx_frac = port->first_frac;
+        port->rx_mask = 0x01;
+        port->rx_data = 0x00;
+        *cctl = regCCTL & ~CAP;         // Switch from capture mode to compare mode
+    }
+    else {
+        *port->rx_ccr_reg += port->bit_ticks;
+        if ((port->rx_frac += port->bit_frac) < port->bit_frac) {
+            ++*port->rx_ccr_reg;
+        }
+
+        if (regCCTL & SCCI) {           // sampled bit value from receive latch
+            port->rx_data |= port->rx_mask;
+        }
+
+        if (!(port->rx_mask <<= 1)) {   // Are all bits received?
+#if defined(SOFTSERIAL_BRIDGE)
+            if (port->bridge_mode) {
+                port_bridge_rx(port, port->rx_data);
+            }
+            else
+#endif
+            {
+                register unsigned next_head = port->rx_buffer.head;
+
+                port->rx_buffer.buffer[next_head++] = port->rx_data;
+                next_head &= PORT_BUFFER_MASK;
+                if (next_head != port->rx_buffer.tail) {
+                    port->rx_buffer.head = next_head;
+                }
+            }
+            *cctl = regCCTL | CAP;      // back to capture mode, wait for the next start bit
+        }
+    }
+}
+
+/**
+ * port_ccr() - run the TX or RX side that owns this CCR
+ */
+
+static inline void port_ccr(uint8_t n)
+{
+    register SoftSerial_t *port = ccr_port[n];
+
+    if (port) {
+        if (port->tx_ccr == n) {
+            port_tx_bit(port);
+        }
+        else {
+            port_rx_bit(port);
+        }
+    }
+}
+
+/**
+ * SoftSerial_port_CCR0_ISR - TA1CCR0 Interrupt Handler
+ */
+
+SOFTSERIAL_ISR(TIMER1_A0_VECTOR, SoftSerial_port_CCR0_ISR)
+{
+    port_ccr(0);
+}
+
+/**
+ * SoftSerial_port_TAIV_ISR - TA1CCR1/TA1CCR2 Interrupt Handler, dispatch on TA1IV
+ */
+
+SOFTSERIAL_ISR(TIMER1_A1_VECTOR, SoftSerial_port_TAIV_ISR)
+{
+    switch (TA1IV) {                    // reading TA1IV resets the highest pending flag
+    case 0x02:                          // TA1CCR1
+        port_ccr(1);
+        break;
+    case 0x04:                          // TA1CCR2
+        port_ccr(2);
+        break;
+    }
+}
+
+#endif /* SOFTSERIAL_PORTS */
@@ -0,0 +1,132 @@
+/**
+ * softserial_port.h - extra software UART ports on Timer1_A3 (msp430g2553)
+ *
+ * softserial.c owns TIMER0_A and stays the fast, hand tuned port. The
+ * ports here share Timer1_A3. Each CCR can be the TX or the RX side of
+ * one port, so the three CCRs give you one full-duplex port plus one
+ * receive-only port, or three receive-only ports for sensors that just
+ * talk. Each port has its own baud rate and its own ring buffers. The
+ * format is 8-N-1.
+ *
+ *   CCR   TX pin (OUTx)   RX pin (CCIxA, CCIS_0)   RX pin (CCIxB, CCIS_1)
+ *    0      P2.0             P2.0                     P2.3
+ *    1      P2.1             P2.1                     P2.2
+ *    2      P2.4             P2.4                     P2.5
+ *
+ *   static SoftSerial_t gps = SOFTSERIAL_PORT(0, BIT0, 1, BIT2, CCIS_1); // TX P2.0, RX P2.2
+ *   static SoftSerial_t co2 = SOFTSERIAL_PORT(SOFTSERIAL_NONE, 0, 2, BIT4, CCIS_0); // RX P2.4
+ *
+ *   SoftSerial_port_init(&gps, 9600);
+ *   SoftSerial_port_init(&co2, 4800);
+ *
+ * Throughput: every bit on every direction of every port is one interrupt.
+ * These handlers go through pointers and cost about 80-100 cycles per bit,
+ * counting interrupt entry, the TA1IV dispatch and reti. Two rules keep all
+ * ports error free, including TIMER0_A:
+ *
+ *  - the sum of baud rate times directions over all ports must stay below
+ *    F_CPU/200, that keeps the CPU under 50% busy with bit interrupts.
+ *    That is 5000 bits/s at 1MHz, 18432 at 3.6864MHz, 80000 at 16MHz.
+ *  - when all CCRs fire at once the last one is serviced up to ~300 cycles
+ *    late, so the fastest port needs F_CPU/BAUD_RATE of 600 or more.
+ *
+ * At 16MHz that allows e.g. TIMER0_A at 9600 full-duplex plus a 9600 full-duplex
+ * port plus a 9600 receive-only port (48000 bits/s). None of these numbers
+ * are measured, they are estimates from instruction counts. isr_budget.py
+ * only counts the softserial.c ISRs and the sim/ tests don't count cycles.
+ * Check your mix of ports on the board with a scope before relying on it.
+ *
+ * License: Do with this code what you want. However, don't blame
+ * me if you connect it to a heart pump and it stops.  This source
+ * is provided as is with no warranties. It probably has bugs!!
+ * You have been warned!
+ *
+ * Author: Rick Kimball
+ * email: rick@kimballsoftware.com
+ */
+
+#ifndef SOFTSERIAL_PORT_H_
+#define SOFTSERIAL_PORT_H_
+
+#include <stdint.h>
+#include "config.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifndef SOFTSERIAL_PORT_BUFFER_SIZE
+#define SOFTSERIAL_PORT_BUFFER_SIZE 16  // RX and TX ring buffer size of each port, a power of 2
+#endif
+
+#define SOFTSERIAL_NONE 0xFF            // use as tx_ccr or rx_ccr for a one way port
+
+/**
+ * typedef port_ringbuffer_t - ring buffer structure of a port
+ */
+typedef struct {
+    uint8_t buffer[SOFTSERIAL_PORT_BUFFER_SIZE];
+    volatile unsigned head;
+    volatile unsigned tail;
+} port_ringbuffer_t;
+
+/**
+ * typedef SoftSerial_t - one port. Fill in the first five fields with SOFTSERIAL_PORT(),
+ *                        the rest belongs to softserial_port.c
+ */
+typedef struct SoftSerial_t {
+    uint8_t tx_ccr;                     // Timer1_A3 CCR for TX 0-2, or SOFTSERIAL_NONE
+    uint8_t tx_pin;                     // P2 bit of the TX pin
+    uint8_t rx_ccr;                     // Timer1_A3 CCR for RX 0-2, or SOFTSERIAL_NONE
+    uint8_t rx_pin;                     // P2 bit of the RX pin
+    uint16_t rx_ccis;                   // CCIS_0 or CCIS_1, see the table above
+
+    volatile uint16_t *tx_cctl;     // TA1CCTLx and TA1CCRx of the TX and RX side
+    volatile uint16_t *tx_ccr_reg;
+    volatile uint16_t *rx_cctl;
+    volatile uint16_t *rx_ccr_reg;
+
+    uint16_t bit_ticks;                 // F_CPU/baud as 16.16 fixed point, see softserial.c
+    uint16_t bit_frac;
+    uint16_t first_ticks;               // start bit edge to the middle of the first data bit
+    uint16_t first_frac;
+    uint16_t tx_frac;
+    uint16_t rx_frac;
+
+    volatile unsigned int txbits;       // frame being sent, like USARTTXBUF
+    uint8_t rx_mask;                    // sliding bit mask, also the loop end flag
+    uint8_t rx_data;                    // bits received so far
+    uint8_t tx_drain;                   // the queue ran dry, idle bits until the stop bit is out
+
+    port_ringbuffer_t rx_buffer;
+    port_ringbuffer_t tx_buffer;
+
+#if defined(SOFTSERIAL_BRIDGE)
+    uint8_t bridge_mode;                // see SoftSerial_port_bridge()
+    struct SoftSerial_t *bridge_to;
+    const uint8_t *bridge_xlat;
+    const uint8_t *bridge_pass;
+#endif
+} SoftSerial_t;
+
+#define SOFTSERIAL_PORT(tx_ccr, tx_pin, rx_ccr, rx_pin, rx_ccis) { (tx_ccr), (tx_pin), (rx_ccr), (rx_pin), (rx_ccis) }
+
+void SoftSerial_port_init(SoftSerial_t *port, unsigned long baud);
+void SoftSerial_port_end(SoftSerial_t *port);
+
+unsigned SoftSerial_port_available(SoftSerial_t *port);
+unsigned SoftSerial_port_empty(SoftSerial_t *port);
+int SoftSerial_port_read(SoftSerial_t *port);
+void SoftSerial_port_xmit(SoftSerial_t *port, uint8_t c);
+unsigned SoftSerial_port_put(SoftSerial_t *port, uint8_t c);
+unsigned SoftSerial_port_tx_free(SoftSerial_t *port);
+void SoftSerial_port_flush(SoftSerial_t *port);
+#if defined(SOFTSERIAL_BRIDGE)
+void SoftSerial_port_bridge(SoftSerial_t *port, unsigned mode, SoftSerial_t *to,
+                            const uint8_t *xlat, const uint8_t *pass);
+#endif
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+#endif /*SOFTSERIAL_PORT_H_*/
@@ -0,0 +1,264 @@
+/**
+ * softserial_print.c - decimal, hex and fixed point output without division
+ *
+ * Decimal digits come from subtracting powers of ten, at most 9 times per
+ * digit. Values that fit in 16 bits never touch 32 bit math. The fraction
+ * of a fixed point number is kept as 0.28 so each decimal is a multiply
+ * by 10 from two shifts and an add, and the digit is the top nibble.
+ * See softserial_print.h.
+ *
+ * License: Do with this code what you want. However, don't blame
+ * me if you connect it to a heart pump and it stops.  This source
+ * is provided as is with no warranties. It probably has bugs!!
+ * You have been warned!
+ *
+ * Author: Rick Kimball
+ * email: rick@kimballsoftware.com
+ */
+
+#include <msp430.h>
+#include <stdint.h>
+#include "config.h"
+#include "softserial.h"
+#include "softserial_print.h"
+
+#if defined(SOFTSERIAL_PRINT)
+
+#define DEC_MAX     10      // digits in 4294967295
+#define DECIMALS_MAX 9      // fraction digits, 0.28 doesn't resolve more
+#define FRAC_ONE    0x10000000UL    // 1.0 in 0.28
+
+//--------------------------------------------------------------------------------
+// F I L E   G L O B A L S
+//--------------------------------------------------------------------------------
+
+static const uint32_t pow10_32[] = { 1000000000UL, 100000000UL, 10000000UL, 1000000UL, 100000UL, 10000UL };
+static const uint16_t pow10_16[] = { 10000, 1000, 100, 10 };
+static const uint8_t hex_digit[] = "0123456789ABCDEF";
+static const uint8_t pad_space[] = "                ";
+static const uint8_t pad_zero[]  = "0000000000000000";
+
+static uint8_t *put_udec(uint8_t *p, uint32_t v);
+static void put_field(uint8_t *buf, uint8_t *end, uint8_t sign, unsigned fmt);
+
+//--------------------------------------------------------------------------------
+// E X P O S E D   E X T E R N A L   F U N C T I O N S
+//--------------------------------------------------------------------------------
+
+/**
+ * SoftSerial_print() - queue a string, like puts() but without a newline
+ */
+
+void SoftSerial_print(const char *s)
+{
+    register const char *e = s;
+
+    while (*e) {
+        ++e;
+    }
+    SoftSerial_write_block((const uint8_t *)s, e - s);
+}
+
+/**
+ * SoftSerial_print_udec() - unsigned decimal in a field of fmt
+ */
+
+void SoftSerial_print_udec(uint32_t v, unsigned fmt)
+{
+    uint8_t buf[DEC_MAX];
+
+    put_field(buf, put_udec(buf, v), (fmt & SOFTSERIAL_FMT_PLUS) ? '+' : 0, fmt);
+}
+
+/**
+ * SoftSerial_print_dec() - signed decimal in a field of fmt
+ */
+
+void SoftSerial_print_dec(int32_t v, unsigned fmt)
+{
+    uint8_t buf[DEC_MAX];
+    register uint8_t sign = (fmt & SOFTSERIAL_FMT_PLUS) ? '+' : 0;
+    register uint32_t u = v;
+
+    if (v < 0) {
+        u = -u;                     // unsigned, so INT32_MIN comes out right too
+        sign = '-';
+    }
+    put_field(buf, put_udec(buf, u), sign, fmt);
+}
+
+/**
+ * SoftSerial_print_hex() - upper case hex, digits wide with leading 0s
+ *
+ * digits 0 prints as many as the value needs, at least one.
+ */
+
+void SoftSerial_print_hex(uint32_t v, unsigned digits)
+{
+    uint8_t buf[8];
+    register uint8_t *p = buf;
+
+    if (!digits) {
+        for (digits = 1; digits < 8 && (v >> (digits << 2)); ++digits) {
+            ; // count the nibbles in use
+        }
+    }
+    else if (digits > 8) {
+        digits = 8;
+    }
+
+    v <<= (8 - digits) << 2;        // first digit in the top nibble
+    do {
+        *p++ = hex_digit[(uint16_t)(v >> 28)];
+        v <<= 4;
+    } while (--digits);
+
+    SoftSerial_write_block(buf, p - buf);
+}
+
+/**
+ * SoftSerial_print_fixed() - fixed point number with frac_bits fraction bits, rounded to decimals
+ *
+ * Q8.8 temperature in an int16_t is (t, 8, 1, fmt), 16.16 is (v, 16, 4, fmt).
+ * frac_bits can be 0 to 28, decimals 0 to 9. Halves round away from 0.
+ */
+
+void SoftSerial_print_fixed(int32_t v, unsigned frac_bits, unsigned decimals, unsigned fmt)
+{
+    uint8_t buf[DEC_MAX + 1 + DECIMALS_MAX];
+    register uint8_t sign = (fmt & SOFTSERIAL_FMT_PLUS) ? '+' : 0;
+    register uint32_t u = v;
+    register uint32_t frac;
+    register uint8_t *p;
+    register unsigned i;
+
+    if (v < 0) {
+        u = -u;
+        sign = '-';
+    }
+    if (frac_bits > 28) {
+        frac_bits = 28;
+    }
+    if (decimals > DECIMALS_MAX) {
+        decimals = DECIMALS_MAX;
+    }
+
+    frac = (u << (28 - frac_bits)) & (FRAC_ONE - 1);
+    u >>= frac_bits;
+
+    p = &buf[DEC_MAX + 1];          // decimals first, rounding may carry into the integer part
+    for (i = 0; i < decimals; ++i) {
+        frac = (frac << 3) + (frac << 1);
+        p[i] = '0' + (uint8_t)(frac >> 28);
+        frac &= FRAC_ONE - 1;
+    }
+    if (frac & (FRAC_ONE >> 1)) {   // what is left is half a digit or more, round up
+        while (i && p[i - 1] == '9') {
+            p[--i] = '0';
+        }
+        if (i) {
+            ++p[i - 1];
+        }
+        else {
+            ++u;
+        }
+    }
+
+    p = put_udec(buf, u);
+    if (decimals) {
+        *p++ = '.';
+        for (i = 0; i < decimals; ++i) {
+            *p++ = buf[DEC_MAX + 1 + i];
+        }
+    }
+    put_field(buf, p, sign, fmt);
+}
+
+//--------------------------------------------------------------------------------
+// I N T E R N A L   F U N C T I O N S
+//--------------------------------------------------------------------------------
+
+/**
+ * put_udec() - decimal digits of v at p, no leading 0s, returns the end
+ */
+
+static uint8_t *put_udec(uint8_t *p, uint32_t v)
+{
+    register uint8_t * const start = p;
+    register const uint16_t *q = pow10_16;
+    register uint16_t w;
+
+    if (v > 0xFFFF) {               // at least 5 digits, the top ones need 32 bits
+        register const uint32_t *q32;
+
+        for (q32 = pow10_32; q32 < &pow10_32[sizeof(pow10_32) / sizeof(pow10_32[0])]; ++q32) {
+            register uint8_t d = '0';
+
+            while (v >= *q32) {
+                v -= *q32;
+                ++d;
+            }
+            if (d != '0' || p != start) {
+                *p++ = d;
+            }
+        }
+        ++q;                        // 10000 is done, v < 10000 now
+    }
+
+    w = v;
+    for (; q < &pow10_16[sizeof(pow10_16) / sizeof(pow10_16[0])]; ++q) {
+        register uint8_t d = '0';
+
+        while (w >= *q) {
+            w -= *q;
+            ++d;
+        }
+        if (d != '0' || p != start) {
+            *p++ = d;
+        }
+    }
+    *p++ = '0' + w;                 // ones, always there so 0 prints as "0"
+
+    return p;
+}
+
+/**
+ * put_pad() - queue n copies of the 16 byte pad pattern
+ */
+
+static void put_pad(const uint8_t *pad, unsigned n)
+{
+    while (n) {
+        register unsigned k = (n > 16) ? 16 : n;
+
+        SoftSerial_write_block(pad, k);
+        n -= k;
+    }
+}
+
+/**
+ * put_field() - queue sign and digits buf..end padded out to the width in fmt
+ */
+
+static void put_field(uint8_t *buf, uint8_t *end, uint8_t sign, unsigned fmt)
+{
+    register unsigned len = (end - buf) + (sign != 0);
+    register unsigned width = fmt & SOFTSERIAL_FMT_WIDTH;
+    register unsigned pad = (width > len) ? width - len : 0;
+
+    if (!(fmt & (SOFTSERIAL_FMT_LEFT | SOFTSERIAL_FMT_ZERO))) {
+        put_pad(pad_space, pad);
+    }
+    if (sign) {
+        SoftSerial_write_block(&sign, 1);
+    }
+    if ((fmt & (SOFTSERIAL_FMT_LEFT | SOFTSERIAL_FMT_ZERO)) == SOFTSERIAL_FMT_ZERO) {
+        put_pad(pad_zero, pad);
+    }
+    SoftSerial_write_block(buf, end - buf);
+    if (fmt & SOFTSERIAL_FMT_LEFT) {
+        put_pad(pad_space, pad);
+    }
+}
+
+#endif /* SOFTSERIAL_PRINT */
@@ -0,0 +1,54 @@
+/**
+ * softserial_print.h - number formatting for the softserial TX queue, no division
+ *
+ * printf() pulls in a software divide for every digit, and the value line
+ * chips have no hardware multiplier or divider to help. These convert by
+ * subtracting powers of ten, shifting nibbles for hex and multiplying the
+ * fraction by 10 with shifts and adds for fixed point. Each call formats
+ * into a small buffer on the stack and hands it to SoftSerial_write_block(),
+ * so the transmitter is started once per field, not once per character.
+ *
+ *   SoftSerial_print("T=");
+ *   SoftSerial_print_fixed(t_q8, 8, 2, 7);          // Q8 value, "  23.50"
+ *   SoftSerial_print(" n=");
+ *   SoftSerial_print_udec(n, 5 | SOFTSERIAL_FMT_ZERO); // "00042"
+ *   SoftSerial_print(" id=");
+ *   SoftSerial_print_hex(id, 4);                    // "01AF"
+ *
+ * The fmt argument is the field width, up to 31, ORed with the flags.
+ * Numbers wider than the field are never cut.
+ *
+ * License: Do with this code what you want. However, don't blame
+ * me if you connect it to a heart pump and it stops.  This source
+ * is provided as is with no warranties. It probably has bugs!!
+ * You have been warned!
+ *
+ * Author: Rick Kimball
+ * email: rick@kimballsoftware.com
+ */
+
+#ifndef SOFTSERIAL_PRINT_H_
+#define SOFTSERIAL_PRINT_H_
+
+#include <stdint.h>
+#include "config.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SOFTSERIAL_FMT_WIDTH 0x1F   // fmt bits with the field width, 0 is no padding
+#define SOFTSERIAL_FMT_LEFT  0x20   // pad with spaces after the number instead of before
+#define SOFTSERIAL_FMT_ZERO  0x40   // pad with '0' between the sign and the digits
+#define SOFTSERIAL_FMT_PLUS  0x80   // '+' in front of positive decimal and fixed point numbers
+
+void SoftSerial_print(const char *s);
+void SoftSerial_print_udec(uint32_t v, unsigned fmt);
+void SoftSerial_print_dec(int32_t v, unsigned fmt);
+void SoftSerial_print_hex(uint32_t v, unsigned digits);     // 1-8 digits, 0 for as many as needed
+void SoftSerial_print_fixed(int32_t v, unsigned frac_bits, unsigned decimals, unsigned fmt);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+#endif /*SOFTSERIAL_PRINT_H_*/